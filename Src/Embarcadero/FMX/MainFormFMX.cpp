@@ -22,6 +22,21 @@ void __fastcall TfrmMainFMX::FormCreate(TObject *Sender)
    catch(std::exception &ex) {
       ShowMessage(ex.what());
    }
+   // actions run in the background, output and progress are fetched by the timer
+   tmPoll = new TTimer(this);
+   tmPoll->Interval = 100;
+   tmPoll->OnTimer = tmPollTimer;
+   OnKeyDown = FormKeyDown;
+}
+//---------------------------------------------------------------------------
+void __fastcall TfrmMainFMX::tmPollTimer(TObject *Sender)
+{
+   proc.Poll();
+}
+//---------------------------------------------------------------------------
+void __fastcall TfrmMainFMX::FormKeyDown(TObject *Sender, WORD &Key, System::WideChar &KeyChar, TShiftState Shift)
+{
+   if(Key == vkEscape) proc.CancelAction();
 }
 //---------------------------------------------------------------------------
 void __fastcall TfrmMainFMX::btnCountClick(TObject *Sender)
@@ -55,3 +70,43 @@ void __fastcall TfrmMainFMX::btnParseClick(TObject *Sender)
    }
 }
 //---------------------------------------------------------------------------
+void __fastcall TfrmMainFMX::btnSnapshotClick(TObject *Sender)
+{
+   try {
+      proc.SnapshotAction();
+      }
+   catch(std::exception &ex) {
+      ShowMessage(ex.what());
+   }
+}
+//---------------------------------------------------------------------------
+void __fastcall TfrmMainFMX::btnRescanClick(TObject *Sender)
+{
+   try {
+      proc.SnapshotAction(true);
+      }
+   catch(std::exception &ex) {
+      ShowMessage(ex.what());
+   }
+}
+//---------------------------------------------------------------------------
+void __fastcall TfrmMainFMX::btnWatchClick(TObject *Sender)
+{
+   try {
+      proc.WatchAction();
+      }
+   catch(std::exception &ex) {
+      ShowMessage(ex.what());
+   }
+}
+//---------------------------------------------------------------------------
+void __fastcall TfrmMainFMX::btnDuplicatesClick(TObject *Sender)
+{
+   try {
+      proc.DuplicatesAction();
+      }
+   catch(std::exception &ex) {
+      ShowMessage(ex.what());
+   }
+}
+//---------------------------------------------------------------------------
@@ -18,6 +18,20 @@ __fastcall TfrmMain::TfrmMain(TComponent* Owner) : TForm(Owner) {
 
 void __fastcall TfrmMain::FormCreate(   TObject *Sender) {
    proc.Init( { this, false });
+   // actions run in the background, output and progress are fetched by the timer
+   tmPoll = new TTimer(this);
+   tmPoll->Interval = 100;
+   tmPoll->OnTimer = tmPollTimer;
+   KeyPreview = true;
+   OnKeyDown = FormKeyDown;
+   }
+//---------------------------------------------------------------------------
+void __fastcall TfrmMain::tmPollTimer(TObject *Sender) {
+   proc.Poll();
+   }
+//---------------------------------------------------------------------------
+void __fastcall TfrmMain::FormKeyDown(TObject *Sender, WORD &Key, TShiftState Shift) {
+   if(Key == VK_ESCAPE) proc.CancelAction();
    }
 //---------------------------------------------------------------------------
 void __fastcall TfrmMain::btnCountClick(TObject *Sender) {
@@ -32,5 +46,21 @@ void __fastcall TfrmMain::btnShowClick(TObject *Sender) {
    proc.ShowAction();
    }
 //---------------------------------------------------------------------------
+void __fastcall TfrmMain::btnSnapshotClick(TObject *Sender) {
+   proc.SnapshotAction();
+   }
+//---------------------------------------------------------------------------
+void __fastcall TfrmMain::btnRescanClick(TObject *Sender) {
+   proc.SnapshotAction(true);
+   }
+//---------------------------------------------------------------------------
+void __fastcall TfrmMain::btnWatchClick(TObject *Sender) {
+   proc.WatchAction();
+   }
+//---------------------------------------------------------------------------
+void __fastcall TfrmMain::btnDuplicatesClick(TObject *Sender) {
+   proc.DuplicatesAction();
+   }
+//---------------------------------------------------------------------------
 
 #endif
@@ -35,12 +35,23 @@ __published:	// Von der IDE verwaltete Komponenten
     TSplitter *Splitter1;
     TButton *btnShow;
     TListBox *lbValues;
+    TButton *btnSnapshot;
+    TButton *btnRescan;
+    TButton *btnWatch;
+    TButton *btnDuplicates;
     void __fastcall FormCreate(TObject *Sender);
     void __fastcall btnCountClick(TObject *Sender);
     void __fastcall btnParseClick(TObject *Sender);
     void __fastcall btnShowClick(TObject *Sender);
+    void __fastcall btnSnapshotClick(TObject *Sender);
+    void __fastcall btnRescanClick(TObject *Sender);
+    void __fastcall btnWatchClick(TObject *Sender);
+    void __fastcall btnDuplicatesClick(TObject *Sender);
 private:	// Benutzer-Deklarationen
     TProcess proc;
+    TTimer* tmPoll;
+    void __fastcall tmPollTimer(TObject *Sender);
+    void __fastcall FormKeyDown(TObject *Sender, WORD &Key, TShiftState Shift);
 public:		// Benutzer-Deklarationen
     __fastcall TfrmMain(TComponent* Owner);
 };
@@ -0,0 +1,592 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include "FileUtil.h"
+#include "FileUtilInternal.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <iterator>
+#include <thread>
+#include <atomic>
+#include <unordered_map>
+#include <optional>
+#include <limits>
+#include <cstring>
+#include <system_error>
+
+#if defined(__linux__)
+   #include <fcntl.h>
+   #include <unistd.h>
+   #include <sys/stat.h>
+   #include <sys/mman.h>
+   #include <ctime>
+#endif
+//---------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+// persistent cache of the content metrics of files. The key is the identity of
+// the content: device, inode, size and time of the last change in ns. The file
+// is a header and a sorted array of fixed records, so it's mapped and searched
+// without parsing. It's never changed in place, a new version is written to a
+// temporary file and renamed over the old one, a reader keeps its old mapping.
+// Limit: files changed within the same timestamp after the count aren't seen,
+// so files changed in the last seconds before the save aren't stored.
+// A save keeps the records of other calls (the parser and the duplicates share
+// one cache), records of files with a new content and unused ones are dropped.
+namespace {
+
+const char iCacheMagic[8] = { 'F', 'A', 'M', 'E', 'T', 'R', '0', '5' };
+const std::int64_t iCacheSettle = std::int64_t { 2 } * 1'000'000'000;   // ns
+const std::uint32_t iCacheKeep  = 30u * 24u * 60u * 60u;                 // s, records unused for longer are dropped
+
+/// bits in TCacheRecord::iValid, for metrics added later
+enum ECacheMetric : std::uint32_t {
+   cache_rows       = 1u,
+   cache_lines_cpp  = 2u,   // kinds of lines with ELineSyntax::cpp
+   cache_lines_text = 4u,   // kinds of lines with ELineSyntax::text
+   cache_hash       = 8u    // fingerprint of the content
+   };
+
+/// bits in TCacheRecord::iMode, how the content was counted
+enum ECacheMode : std::uint8_t {
+   mode_decoded    = 1u,    // UTF-16 decoded
+   mode_compressed = 2u,    // file is in a format with a decompressor
+   mode_inflated   = 4u     // counts of the decompressed content
+   };
+
+struct TCacheKey {
+   std::uint64_t iDevice   = 0u;
+   std::uint64_t iInode    = 0u;
+   std::uint64_t iSize     = 0u;
+   std::int64_t  iModified = 0;
+
+   bool operator < (TCacheKey const& other) const {
+      return std::tie(iDevice, iInode, iSize, iModified) <
+             std::tie(other.iDevice, other.iInode, other.iSize, other.iModified);
+      }
+   bool operator == (TCacheKey const& other) const {
+      return iDevice == other.iDevice && iInode == other.iInode &&
+             iSize == other.iSize && iModified == other.iModified;
+      }
+   };
+
+/// record in the cache file, 96 bytes
+struct TCacheRecord {
+   TCacheKey     key;
+   std::uint32_t iValid        = 0u;    // ECacheMetric
+   std::uint32_t iUsed         = 0u;    // last save with this record, s since epoch
+   std::uint64_t iRows         = 0u;
+   std::uint32_t iCode         = 0u;
+   std::uint32_t iComment      = 0u;
+   std::uint32_t iBlank        = 0u;
+   std::uint32_t iPreprocessor = 0u;
+   TContentHash  hash;
+   std::uint64_t iContent      = 0u;    // size of the counted content
+   std::uint8_t  iKind         = 0u;    // EContentKind + 1, 0 without a sniff
+   std::uint8_t  iMode         = 0u;    // ECacheMode
+   std::uint8_t  iReserved[6]  = { };
+   };
+
+struct TCacheHeader {
+   char          magic[8];
+   std::uint32_t iRecordSize;
+   std::uint32_t iReserved;
+   std::uint64_t iCount;
+   std::uint64_t iReserved2;
+   };
+
+static_assert(sizeof(TCacheRecord) == 96 && sizeof(TCacheHeader) == 32, "layout of the content cache");
+
+/// key of a file for the cache, false for files without a stable content (no regular file, empty)
+bool Cache_Key(fs::path const& file, TCacheKey& key) {
+#if defined(__linux__)
+   struct ::stat status;
+   if(::stat(file.c_str(), &status) != 0 || !S_ISREG(status.st_mode) || status.st_size <= 0) return false;
+   key.iDevice   = status.st_dev;
+   key.iInode    = status.st_ino;
+   key.iSize     = static_cast<std::uint64_t>(status.st_size);
+   key.iModified = static_cast<std::int64_t>(status.st_mtim.tv_sec) * 1'000'000'000 + status.st_mtim.tv_nsec;
+#else
+   std::error_code ec;
+   if(!fs::is_regular_file(file, ec)) return false;
+   const auto iSize = fs::file_size(file, ec);
+   if(ec || iSize == 0u) return false;
+   const auto tWrite = fs::last_write_time(file, ec);
+   if(ec) return false;
+   key.iDevice   = 0u;
+   key.iInode    = std::hash<std::string>{}(fs::absolute(file).string());   // no inode, the name instead
+   key.iSize     = iSize;
+   key.iModified = std::chrono::duration_cast<std::chrono::nanoseconds>(tWrite.time_since_epoch()).count();
+#endif
+   return true;
+   }
+
+std::int64_t Cache_Now() {
+#if defined(__linux__)
+   struct ::timespec now;
+   ::clock_gettime(CLOCK_REALTIME, &now);
+   return static_cast<std::int64_t>(now.tv_sec) * 1'000'000'000 + now.tv_nsec;
+#else
+   const auto now = fs::file_time_type::clock::now();
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(now.time_since_epoch()).count();
+#endif
+   }
+
+/// cache file opened for reading, mapped on linux, a file which doesn't fit is empty
+class TContentCache {
+   public:
+      explicit TContentCache(fs::path const& file);
+      TContentCache(TContentCache const&) = delete;
+      ~TContentCache();
+
+      TCacheRecord const* Find(TCacheKey const& key) const;
+      void Merge(std::vector<TCacheRecord>& records) const;
+      static void Save(fs::path const& file, std::vector<TCacheRecord> records);
+
+   private:
+      TCacheRecord const*       first = nullptr;
+      TCacheRecord const*       last  = nullptr;
+      void*                     view  = nullptr;
+      size_t                    iView = 0u;
+      std::vector<TCacheRecord> storage;
+   };
+
+TContentCache::TContentCache(fs::path const& file) {
+   TCacheHeader header;
+#if defined(__linux__)
+   const int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+   if(fd < 0) return;
+   struct ::stat status;
+   if(::fstat(fd, &status) == 0 && static_cast<size_t>(status.st_size) >= sizeof(TCacheHeader)) {
+      iView = static_cast<size_t>(status.st_size);
+      view  = ::mmap(nullptr, iView, PROT_READ, MAP_PRIVATE, fd, 0);
+      if(view == MAP_FAILED) view = nullptr;
+      }
+   ::close(fd);
+   if(!view) return;
+   std::memcpy(&header, view, sizeof(header));
+   if(!std::equal(header.magic, header.magic + sizeof(header.magic), iCacheMagic) || header.iRecordSize != sizeof(TCacheRecord) ||
+      header.iCount != (iView - sizeof(TCacheHeader)) / sizeof(TCacheRecord) ||
+      iView != sizeof(TCacheHeader) + header.iCount * sizeof(TCacheRecord)) return;
+   first = reinterpret_cast<TCacheRecord const*>(static_cast<char const*>(view) + sizeof(TCacheHeader));
+   last  = first + header.iCount;
+#else
+   // the count is checked against the size of the file, as above, before the storage is allocated
+   std::error_code ec;
+   const auto iSize = fs::file_size(file, ec);
+   if(ec || iSize < sizeof(TCacheHeader)) return;
+   std::ifstream ifs(file, std::ios::binary);
+   if(!ifs.is_open() || !ifs.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+      !std::equal(header.magic, header.magic + sizeof(header.magic), iCacheMagic) ||
+      header.iRecordSize != sizeof(TCacheRecord) ||
+      header.iCount != (iSize - sizeof(TCacheHeader)) / sizeof(TCacheRecord) ||
+      iSize != sizeof(TCacheHeader) + header.iCount * sizeof(TCacheRecord)) return;
+   storage.resize(static_cast<size_t>(header.iCount));
+   if(!ifs.read(reinterpret_cast<char*>(storage.data()), static_cast<std::streamsize>(storage.size() * sizeof(TCacheRecord)))) {
+      storage.clear();
+      return;
+      }
+   first = storage.data();
+   last  = first + storage.size();
+#endif
+   }
+
+TContentCache::~TContentCache() {
+#if defined(__linux__)
+   if(view) ::munmap(view, iView);
+#endif
+   }
+
+TCacheRecord const* TContentCache::Find(TCacheKey const& key) const {
+   auto it = std::lower_bound(first, last, key, [](TCacheRecord const& rec, TCacheKey const& val) { return rec.key < val; });
+   return it != last && it->key == key ? it : nullptr;
+   }
+
+/// add the records of other files to records, without records of files with a new content and unused ones
+void TContentCache::Merge(std::vector<TCacheRecord>& records) const {
+   auto by_key = [](auto const& lhs, auto const& rhs) { return lhs.key < rhs.key; };
+   std::sort(records.begin(), records.end(), by_key);
+   const auto iNow = static_cast<std::uint32_t>(Cache_Now() / 1'000'000'000);
+   const size_t iNew = records.size();
+   for(auto rec = first; rec != last; ++rec) {
+      if(rec->iUsed + std::uint64_t { iCacheKeep } < iNow) continue;
+      TCacheRecord probe;
+      probe.key = TCacheKey { rec->key.iDevice, rec->key.iInode, 0u, std::numeric_limits<std::int64_t>::min() };
+      auto it = std::lower_bound(records.begin(), records.begin() + iNew, probe, by_key);
+      if(it != records.begin() + iNew && it->key.iDevice == rec->key.iDevice && it->key.iInode == rec->key.iInode) continue;
+      records.push_back(*rec);
+      }
+   }
+
+/// write the records as new cache file, the temporary file is unique for concurrent writers
+void TContentCache::Save(fs::path const& file, std::vector<TCacheRecord> records) {
+   std::sort(records.begin(), records.end(), [](auto const& lhs, auto const& rhs) { return lhs.key < rhs.key; });
+   records.erase(std::unique(records.begin(), records.end(), [](auto const& lhs, auto const& rhs) { return lhs.key == rhs.key; }),
+                 records.end());
+
+   const fs::path temp = Create_Temp_File(file);
+   {
+   std::ofstream ofs(temp, std::ios::binary | std::ios::trunc);
+   if(!ofs.is_open()) throw std::runtime_error("error while opening content cache \"" + temp.string() + "\".");
+   TCacheHeader header { { }, sizeof(TCacheRecord), 0u, records.size(), 0u };
+   std::copy(iCacheMagic, iCacheMagic + sizeof(iCacheMagic), header.magic);
+   ofs.write(reinterpret_cast<char const*>(&header), sizeof(header));
+   ofs.write(reinterpret_cast<char const*>(records.data()), static_cast<std::streamsize>(records.size() * sizeof(TCacheRecord)));
+   if(!ofs) {
+      ofs.close();
+      std::error_code ec;
+      fs::remove(temp, ec);
+      throw std::runtime_error("error while writing content cache \"" + temp.string() + "\".");
+      }
+   }
+   std::error_code ec;
+   fs::rename(temp, file, ec);
+   if(ec) {
+      fs::remove(temp, ec);
+      throw std::runtime_error("error while replacing content cache \"" + file.string() + "\".");
+      }
+   }
+
+ECacheMetric Cache_Metric(ELineSyntax eSyntax) {
+   return eSyntax == ELineSyntax::cpp ? cache_lines_cpp : cache_lines_text;
+   }
+
+/// the kinds of lines don't fit into the record when a count is above 32 bit
+bool Store_Lines(TCacheRecord& rec, TLineStats const& stats) {
+   const auto iMax = std::numeric_limits<std::uint32_t>::max();
+   if(stats.iCode > iMax || stats.iComment > iMax || stats.iBlank > iMax || stats.iPreprocessor > iMax) return false;
+   rec.iCode         = static_cast<std::uint32_t>(stats.iCode);
+   rec.iComment      = static_cast<std::uint32_t>(stats.iComment);
+   rec.iBlank        = static_cast<std::uint32_t>(stats.iBlank);
+   rec.iPreprocessor = static_cast<std::uint32_t>(stats.iPreprocessor);
+   return true;
+   }
+
+/// mode of the counts of a file with the settings
+std::uint8_t Cache_Mode(bool boCompressed, EContentKind eKind, EBinaryPolicy ePolicy, bool boInflate) {
+   std::uint8_t ret = 0u;
+   if(boCompressed) ret |= mode_compressed;
+   if(boCompressed && boInflate) ret |= mode_inflated;
+   if(Is_Decoded(eKind, ePolicy)) ret |= mode_decoded;
+   return ret;
+   }
+
+/// stats from the record when it has all needed metrics for the settings; skipped files need only their kind
+bool Cached_Lines(TCacheRecord const& rec, EBinaryPolicy ePolicy, bool boInflate, std::uint32_t iNeeded, TLineStats& stats) {
+   if(rec.iKind == 0u || (rec.iValid & iNeeded & cache_hash) != (iNeeded & cache_hash)) return false;
+   const auto eKind = static_cast<EContentKind>(rec.iKind - 1u);
+   const bool boCompressed = (rec.iMode & mode_compressed) != 0u;
+   if(((rec.iMode & mode_inflated) != 0u) != (boInflate && boCompressed)) return false;   // the kind is of the other content
+   if(Is_Skipped(eKind, ePolicy)) {
+      stats = TLineStats { 0u, 0u, 0u, 0u, 0u, eKind, 0u, boCompressed };
+      return true;
+      }
+   if((rec.iValid & iNeeded) != iNeeded || rec.iMode != Cache_Mode(boCompressed, eKind, ePolicy, boInflate)) return false;
+   stats = TLineStats { rec.iRows, rec.iCode, rec.iComment, rec.iBlank, rec.iPreprocessor, eKind, rec.iContent, boCompressed };
+   return true;
+   }
+
+/**
+  \brief rows or lines of the files with a pool of workers, files with a key in the cache aren't read
+  \details without syntax only the rows are counted. A file which is read with a cache or
+           for hashes gets its fingerprint in the same pass, hashes gets it for every file
+           without error; for them files skipped by the binary policy are read completely.
+           text gets the wc- style statistic of every file, it isn't cached, so all files
+           are read then. records gets the records of all files with a key, found or
+           counted, for a new cache
+*/
+std::vector<TLineStats> Count_Pool(std::vector<fs::path> const& files, std::vector<ELineSyntax> const* syntax,
+                                   EBinaryPolicy ePolicy, TContentCache const* cache, std::vector<TCacheRecord>* records,
+                                   std::vector<std::optional<TContentHash>>* hashes = nullptr,
+                                   std::vector<TTextStats>* text = nullptr) {
+   std::vector<TLineStats>   ret(files.size());
+   std::vector<std::string>  errors(files.size());
+   std::vector<TCacheRecord> found(cache ? files.size() : 0u);
+   std::atomic<size_t>       next { 0u };
+   const bool boInflate = Get_Decompression();
+   auto& control = Scan_Control();
+   if(text) text->assign(files.size(), TTextStats { });
+   auto count = [&files, syntax, ePolicy, boInflate, hashes, text](size_t i, TContentHasher* hasher, std::uint64_t& iBytes) {
+      return Count_File(files[i], syntax ? &(*syntax)[i] : nullptr, ePolicy, boInflate, hasher,
+                        text ? &(*text)[i] : nullptr, hashes != nullptr, iBytes);
+      };
+   auto worker = [&]() {
+      for(size_t i; (i = next++) < files.size(); ) {
+         if(control.Cancelled()) break;
+         std::uint64_t iBytes = 0u;
+         try {
+            if(cache && Cache_Key(files[i], found[i].key)) {
+               const std::uint32_t iNeeded = (syntax ? Cache_Metric((*syntax)[i]) : cache_rows) | (hashes ? cache_hash : 0u);
+               auto rec = cache->Find(found[i].key);
+               if(rec && !text && Cached_Lines(*rec, ePolicy, boInflate, iNeeded, ret[i])) found[i] = *rec;
+               else {
+                  if(rec) found[i] = *rec;    // keeps the lines of the other syntax
+                  TContentHasher hasher;
+                  ret[i] = count(i, &hasher, iBytes);
+                  const auto eKind = ret[i].eKind;
+                  const auto iMode = Cache_Mode(ret[i].boCompressed, eKind, ePolicy, boInflate);
+                  if(found[i].iMode != iMode) found[i].iValid &= cache_hash;
+                  found[i].iKind = static_cast<std::uint8_t>(static_cast<int>(eKind) + 1);
+                  found[i].iMode = iMode;
+                  if(!Is_Skipped(eKind, ePolicy) || hashes) {
+                     found[i].hash    = hasher.Final();
+                     found[i].iValid |= cache_hash;
+                     }
+                  if(!Is_Skipped(eKind, ePolicy)) {
+                     found[i].iRows    = ret[i].iRows;
+                     found[i].iContent = ret[i].iBytes;
+                     found[i].iValid |= cache_rows;
+                     if(syntax && Store_Lines(found[i], ret[i])) found[i].iValid |= Cache_Metric((*syntax)[i]);
+                     }
+                  }
+               if(hashes) (*hashes)[i] = found[i].hash;
+               }
+            else if(hashes) {
+               TContentHasher hasher;
+               ret[i] = count(i, &hasher, iBytes);
+               (*hashes)[i] = hasher.Final();
+               }
+            else ret[i] = count(i, nullptr, iBytes);
+            }
+         catch(TScanCancelled const&) {
+            if(cache) found[i].iValid = found[i].iKind = found[i].iMode = 0u;
+            break;
+            }
+         catch(std::exception& ex) {
+            errors[i] = ex.what();
+            if(cache) found[i].iValid = found[i].iKind = found[i].iMode = 0u;
+            if(hashes) (*hashes)[i].reset();
+            }
+         control.Add_Files(1u, iBytes);
+         }
+      };
+
+   const size_t iWorkers = std::min<size_t>(Get_Traversal_Threads(), files.size());
+   std::vector<std::thread> threads;
+   for(size_t i = 1u; i < iWorkers; ++i) threads.emplace_back(worker);
+   worker();
+   std::for_each(threads.begin(), threads.end(), [](auto& thread) { thread.join(); });
+   control.Check();
+
+   for(size_t i = 0u; i < files.size(); ++i) {
+      if(!errors[i].empty()) std::cerr << "error in CheckFileSize: " << errors[i] << std::endl;
+      }
+
+   if(records) {
+      const auto iNow     = Cache_Now();
+      const auto iSettled = iNow - iCacheSettle;
+      const auto iUsed    = static_cast<std::uint32_t>(iNow / 1'000'000'000);
+      for(auto& rec : found) {
+         if((rec.iValid == 0u && rec.iKind == 0u) || rec.key.iModified >= iSettled) continue;
+         rec.iUsed = iUsed;
+         records->push_back(rec);
+         }
+      }
+   return ret;
+   }
+
+/// Count_Pool() with the cache in cache_file, which gets the records of the files afterwards
+std::vector<TLineStats> Count_Cached(std::vector<fs::path> const& files, std::vector<ELineSyntax> const* syntax,
+                                     fs::path const& cache_file,
+                                     std::vector<std::optional<TContentHash>>* hashes = nullptr,
+                                     std::vector<TTextStats>* text = nullptr) {
+   std::vector<TCacheRecord> records;
+   std::vector<TLineStats> ret;
+   {
+   TContentCache cache(cache_file);
+   ret = Count_Pool(files, syntax, Get_Binary_Policy(), &cache, &records, hashes, text);
+   cache.Merge(records);
+   }
+   try {
+      TContentCache::Save(cache_file, std::move(records));
+      }
+   catch(std::exception& ex) {
+      std::cerr << "error in " << __func__ << ": " << ex.what() << std::endl;
+      }
+   return ret;
+   }
+
+} // end of anonymous namespace
+
+
+/// file of the content cache for a scanned directory, in the cache directory of the user
+fs::path Content_Cache_File(fs::path const& dir) {
+   std::ostringstream os;
+   os << "FileApp_" << std::hex << std::hash<std::string>{}(fs::absolute(dir).string()) << ".metrics";
+   return Cache_Directory() / os.str();
+   }
+
+
+/// rows of a file, the count of '\n' with the binary policy; errors are reported and give 0
+size_t CheckFileSize(fs::path const& strFile) {
+   size_t ret = 0u;
+   try {
+      std::uint64_t iBytes;
+      ret = static_cast<size_t>(Count_File(strFile, nullptr, Get_Binary_Policy(), Get_Decompression(), nullptr, nullptr, false, iBytes).iRows);
+      }
+   catch(std::exception & ex) {
+      std::cerr << "error in " << __func__ << ": " << ex.what() << std::endl;
+      }
+   return ret;
+   }
+
+/**
+  \brief rows of many files with a pool of workers, the result in the order of the files
+  \details errors are reported in the calling thread after all files are counted,
+           such a file has 0 rows. The workers stop when the scan is cancelled.
+*/
+std::vector<size_t> Count_Rows(std::vector<fs::path> const& files) {
+   const auto stats = Count_Pool(files, nullptr, Get_Binary_Policy(), nullptr, nullptr);
+   std::vector<size_t> ret(stats.size());
+   std::transform(stats.begin(), stats.end(), ret.begin(), [](auto const& val) { return static_cast<size_t>(val.iRows); });
+   return ret;
+   }
+
+/**
+  \brief rows, kind and size of the content of many files with a pool of workers
+  \details the binary policy isn't used, all content is read. With Set_Decompression()
+           iBytes is the uncompressed size of compressed files. Errors like in Count_Rows()
+*/
+std::vector<TLineStats> Count_Content(std::vector<fs::path> const& files) {
+   return Count_Pool(files, nullptr, EBinaryPolicy::count, nullptr, nullptr);
+   }
+
+/**
+  \brief wc- style statistic of many files with a pool of workers, with the binary policy
+  \details skipped files have an empty statistic, errors like in Count_Rows()
+*/
+std::vector<TTextStats> Count_Text(std::vector<fs::path> const& files) {
+   std::vector<TTextStats> ret;
+   Count_Pool(files, nullptr, Get_Binary_Policy(), nullptr, nullptr, nullptr, &ret);
+   return ret;
+   }
+
+/**
+  \brief Count_Rows() with the persistent content cache in cache_file
+  \details unchanged files are answered from the cache with one stat, the others
+           are read and get their fingerprint in the same pass. The records of these
+           files replace the old ones in the cache, records of other files are kept
+           until they are unused for 30 days. A cancelled call leaves the cache unchanged.
+*/
+std::vector<size_t> Count_Rows(std::vector<fs::path> const& files, fs::path const& cache_file) {
+   const auto stats = Count_Cached(files, nullptr, cache_file);
+   std::vector<size_t> ret(stats.size());
+   std::transform(stats.begin(), stats.end(), ret.begin(), [](auto const& val) { return static_cast<size_t>(val.iRows); });
+   return ret;
+   }
+
+/**
+  \brief lines of many files by kind, with the syntax of the same position, and rows
+  \details the lines are classified in the same pass which counts the rows, errors
+           and the cache are handled like in Count_Rows()
+*/
+std::vector<TLineStats> Count_Lines(std::vector<fs::path> const& files, std::vector<ELineSyntax> const& syntax,
+                                    fs::path const& cache_file) {
+   if(syntax.size() != files.size()) throw std::invalid_argument("Count_Lines: one syntax for every file expected");
+   return Count_Cached(files, &syntax, cache_file);
+   }
+
+/**
+  \brief Count_Lines() with the wc- style statistic of the files in the same pass
+  \details the statistic isn't part of the cache, all files are read, the cache gets
+           the records of the counts anyway
+*/
+std::vector<TLineStats> Count_Lines(std::vector<fs::path> const& files, std::vector<ELineSyntax> const& syntax,
+                                    fs::path const& cache_file, std::vector<TTextStats>& text) {
+   if(syntax.size() != files.size()) throw std::invalid_argument("Count_Lines: one syntax for every file expected");
+   return Count_Cached(files, &syntax, cache_file, nullptr, &text);
+   }
+
+
+//----------------------------------------------------------------------------
+// duplicates: only files with a shared size get their fingerprint, through the
+// content cache, files with the same fingerprint are compared byte by byte
+namespace {
+
+/// files of a group with equal hashes split into the groups of really equal content, the order is kept
+std::vector<std::vector<fs::path>> Split_By_Content(std::vector<fs::path> files) {
+   std::vector<std::vector<fs::path>> ret;
+   while(files.size() > 1u) {
+      std::vector<fs::path> same { files.front() }, other;
+      for(size_t i = 1u; i < files.size(); ++i) (Same_Content(files.front(), files[i]) ? same : other).emplace_back(std::move(files[i]));
+      if(same.size() > 1u) ret.emplace_back(std::move(same));
+      files = std::move(other);
+      }
+   return ret;
+   }
+
+} // end of anonymous namespace
+
+/**
+  \brief groups of files with the same content, the largest files first
+  \details only files whose size is shared by another file are read, the others
+           can't have a duplicate. The fingerprints of unchanged files come from the
+           content cache in cache_file, new ones are stored there. Files with the same
+           fingerprint are compared byte by byte by a pool of workers before they are
+           reported, a collision of the hash can't give a wrong group. Empty files, files
+           which aren't regular and unreadable files aren't part of a group.
+*/
+std::vector<TDuplicateGroup> Find_Duplicates(std::vector<fs::path> const& files, fs::path const& cache_file) {
+   const auto status = Stat_Files(files);
+   Scan_Control().Check();
+
+   std::unordered_map<std::uintmax_t, size_t> sizes;
+   for(auto const& state : status) {
+      if(state.boValid && state.boRegular && state.iSize > 0u) ++sizes[state.iSize];
+      }
+
+   std::vector<fs::path>       candidates;
+   std::vector<std::uintmax_t> candidate_sizes;
+   for(size_t i = 0u; i < files.size(); ++i) {
+      if(!status[i].boValid || !status[i].boRegular || status[i].iSize == 0u || sizes[status[i].iSize] < 2u) continue;
+      candidates.emplace_back(files[i]);
+      candidate_sizes.emplace_back(status[i].iSize);
+      }
+
+   std::vector<std::optional<TContentHash>> hashes(candidates.size());
+   Count_Cached(candidates, nullptr, cache_file, &hashes);
+
+   std::vector<size_t> order;
+   for(size_t i = 0u; i < candidates.size(); ++i) if(hashes[i]) order.emplace_back(i);
+   std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) {
+         if(candidate_sizes[lhs] != candidate_sizes[rhs]) return candidate_sizes[lhs] > candidate_sizes[rhs];
+         if(*hashes[lhs] != *hashes[rhs]) return *hashes[lhs] < *hashes[rhs];
+         return candidates[lhs] < candidates[rhs];
+         });
+
+   std::vector<TDuplicateGroup> hashed;
+   for(auto it = order.begin(); it != order.end(); ) {
+      auto group_end = std::find_if(it + 1, order.end(), [&](size_t idx) {
+                           return candidate_sizes[idx] != candidate_sizes[*it] || *hashes[idx] != *hashes[*it];
+                           });
+      if(group_end - it > 1) {
+         TDuplicateGroup group { candidate_sizes[*it], *hashes[*it], { } };
+         std::transform(it, group_end, std::back_inserter(group.files), [&candidates](size_t idx) { return candidates[idx]; });
+         hashed.emplace_back(std::move(group));
+         }
+      it = group_end;
+      }
+
+   std::vector<std::vector<std::vector<fs::path>>> verified(hashed.size());
+   std::atomic<size_t> next { 0u };
+   auto worker = [&]() {
+      for(size_t i; (i = next++) < hashed.size(); ) verified[i] = Split_By_Content(hashed[i].files);
+      };
+   const size_t iWorkers = std::min<size_t>(Get_Traversal_Threads(), hashed.size());
+   std::vector<std::thread> threads;
+   for(size_t i = 1u; i < iWorkers; ++i) threads.emplace_back(worker);
+   worker();
+   std::for_each(threads.begin(), threads.end(), [](auto& thread) { thread.join(); });
+   Scan_Control().Check();
+
+   std::vector<TDuplicateGroup> ret;
+   for(size_t i = 0u; i < hashed.size(); ++i) {
+      for(auto& same : verified[i]) ret.emplace_back(TDuplicateGroup { hashed[i].iSize, hashed[i].hash, std::move(same) });
+      }
+   return ret;
+   }
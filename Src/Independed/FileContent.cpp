@@ -0,0 +1,536 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include "FileUtil.h"
+#include "FileUtilInternal.h"
+
+#include <fstream>
+#include <algorithm>
+#include <mutex>
+#include <cstring>
+#include <cstdlib>
+#include <optional>
+
+#if defined(__linux__)
+   #include <fcntl.h>
+   #include <unistd.h>
+   #include <sys/stat.h>
+   #include <sys/mman.h>
+#endif
+//---------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+// content of files for the row counters. Regular files between iMapMin and the
+// map limit are mapped and the kernels run directly over the pages of the
+// cache. Small files (mmap costs more than a read), pipes, special files and
+// files above the limit are read in blocks into a buffer of the thread.
+// The start of the first block is sniffed for the kind of the content, files
+// which aren't text are skipped after it or decoded as the policy says.
+// Compressed files (gzip with zlib, zstd with libzstd, when the build defines
+// FILEAPP_WITH_ZLIB / FILEAPP_WITH_ZSTD) can be decompressed on the fly through
+// a window of fixed size, the counters never see more than one window.
+// For scans which shouldn't displace the page cache of other programs the
+// blocks are read and the pages which weren't in the cache before (mincore)
+// are dropped after each block, or the cache is bypassed with O_DIRECT.
+namespace {
+
+const size_t  iMapMin       = 64u * 1024u;
+const size_t  iMapChunk     = 4u * 1024u * 1024u;   // part of a mapped file for the callback, cancelled between them
+const size_t  iStreamBlock  = 1024u * 1024u;
+const size_t  iSniffSize    = 4096u;
+size_t        iMapLimit     = size_t { 1024u } * 1024u * 1024u;
+EBinaryPolicy eBinaryPolicy = EBinaryPolicy::decode;
+EReadMode     eReadMode     = EReadMode::cached;
+
+/// buffer for the streaming reader, reused for all files of the thread; a second reader of the thread uses slot 1
+std::vector<char>& Stream_Buffer(size_t iSlot = 0u) {
+   thread_local std::vector<char> buffers[2];
+   if(buffers[iSlot].empty()) buffers[iSlot].resize(iStreamBlock);
+   return buffers[iSlot];
+   }
+
+#if defined(__linux__)
+const size_t iDirectAlign = 4096u;
+
+/// buffer for O_DIRECT, aligned for the block devices, reused for all files of the thread
+char* Direct_Buffer(size_t iSlot = 0u) {
+   struct TDirectBuffer {
+      void* data = nullptr;
+      ~TDirectBuffer() { std::free(data); }
+      };
+   thread_local TDirectBuffer buffers[2];
+   auto& buffer = buffers[iSlot];
+   if(!buffer.data && ::posix_memalign(&buffer.data, iDirectAlign, iStreamBlock) != 0) buffer.data = nullptr;
+   if(!buffer.data) throw std::bad_alloc();
+   return static_cast<char*>(buffer.data);
+   }
+
+/**
+  \brief pages of a file which the reader brought into the page cache, dropped after each block
+  \details a view of the file (no page is touched) tells with mincore which pages are
+           resident before the first read. After each block only the others are dropped,
+           so files which other programs use stay in the cache, and the read-ahead of the
+           kernel is dropped with the block which uses it. Without the view every block is
+           dropped completely.
+*/
+class TPageDropper {
+   public:
+      TPageDropper(int fd, std::uint64_t iSize) : iFile(fd), iPage(static_cast<size_t>(::sysconf(_SC_PAGESIZE))) {
+         if(iSize == 0u) return;
+         void* view = ::mmap(nullptr, static_cast<size_t>(iSize), PROT_READ, MAP_SHARED, fd, 0);
+         if(view == MAP_FAILED) return;
+         resident.resize((static_cast<size_t>(iSize) + iPage - 1u) / iPage);
+         if(::mincore(view, static_cast<size_t>(iSize), resident.data()) != 0) resident.clear();
+         ::munmap(view, static_cast<size_t>(iSize));
+         }
+
+      void Drop(std::uint64_t iOffset, std::uint64_t iLength) const {
+         if(resident.empty()) {
+            ::posix_fadvise(iFile, static_cast<off_t>(iOffset), static_cast<off_t>(iLength), POSIX_FADV_DONTNEED);
+            return;
+            }
+         // the block starts and ends on page boundaries (buffer of whole pages), the last page is complete
+         const size_t iEnd = std::min(resident.size(), static_cast<size_t>((iOffset + iLength + iPage - 1u) / iPage));
+         for(size_t i = static_cast<size_t>(iOffset / iPage); i < iEnd; ) {
+            if(resident[i] & 1u) { ++i; continue; }
+            size_t j = i;
+            while(j < iEnd && !(resident[j] & 1u)) ++j;
+            ::posix_fadvise(iFile, static_cast<off_t>(i * iPage), static_cast<off_t>((j - i) * iPage), POSIX_FADV_DONTNEED);
+            i = j;
+            }
+         }
+
+   private:
+      int                        iFile;
+      size_t                     iPage;
+      std::vector<unsigned char> resident;
+   };
+#endif
+
+} // end of anonymous namespace
+
+
+#if defined(__linux__)
+thread_local TMapGuard* TMapGuard::guards = nullptr;
+struct sigaction        TMapGuard::former;
+
+TMapGuard::TMapGuard(void* view, size_t iSize, int iProtection) : begin(static_cast<char*>(view)), end(begin + iSize),
+            iPage(static_cast<size_t>(::sysconf(_SC_PAGESIZE))), iAccess(iProtection), next(guards) {
+   static std::once_flag installed;
+   std::call_once(installed, []() {
+      struct sigaction action { };
+      action.sa_sigaction = &TMapGuard::Handler;
+      action.sa_flags     = SA_SIGINFO | SA_ONSTACK;
+      ::sigemptyset(&action.sa_mask);
+      ::sigaction(SIGBUS, &action, &former);
+      });
+   guards = this;
+   }
+
+TMapGuard::~TMapGuard() {
+   for(auto** link = &guards; *link; link = &(*link)->next) {
+      if(*link == this) {
+         *link = next;
+         break;
+         }
+      }
+   }
+
+void TMapGuard::Handler(int iSignal, siginfo_t* info, void* context) {
+   auto const* address = static_cast<char const*>(info->si_addr);
+   for(auto* guard = guards; guard; guard = guard->next) {
+      if(address < guard->begin || address >= guard->end) continue;
+      char* page = guard->begin + static_cast<size_t>(address - guard->begin) / guard->iPage * guard->iPage;
+      if(::mmap(page, static_cast<size_t>(guard->end - page), guard->iAccess, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1, 0) == MAP_FAILED) break;
+      guard->boFault = 1;
+      return;
+      }
+   if(former.sa_flags & SA_SIGINFO) former.sa_sigaction(iSignal, info, context);
+   else if(former.sa_handler != SIG_DFL && former.sa_handler != SIG_IGN) former.sa_handler(iSignal);
+   else ::sigaction(SIGBUS, &former, nullptr);   // the access is repeated and ends the process
+   }
+#endif
+
+
+namespace {
+
+/**
+  \brief content of a file block by block, in the read mode of the scan
+  \details a mapped file comes in blocks of iMapChunk bytes of the view, else the blocks
+           are read into the buffer of the slot. Two readers of the same thread (comparison of files) need different
+           slots. A block is valid until the next call of Next(). A truncation of a mapped
+           file under the reader raises a filesystem_error in the next call of Next() or
+           Check().
+*/
+class TBlockReader {
+   public:
+      explicit TBlockReader(fs::path const& file, size_t iSlot = 0u);
+      TBlockReader(TBlockReader const&) = delete;
+      ~TBlockReader();
+
+      /// next block of the content, empty at the end of the file
+      std::string_view Next();
+      void Check() const;
+
+   private:
+      fs::path                    path;
+#if defined(__linux__)
+      struct TFileHandle {
+         int fd = -1;
+         ~TFileHandle() { if(fd >= 0) ::close(fd); }
+         };
+      struct TMapping {
+         void*  view  = nullptr;
+         size_t iSize = 0u;
+         ~TMapping() { if(view) ::munmap(view, iSize); }
+         };
+      TFileHandle                 handle;
+      TMapping                    mapping;
+      std::optional<TMapGuard>    guard;
+      std::optional<TPageDropper> dropper;
+      std::uint64_t               iSize   = 0u;
+      std::uint64_t               iOffset = 0u;
+      char*                       buffer  = nullptr;
+#else
+      std::ifstream               ifs;
+      std::vector<char>&          buffer;
+#endif
+   };
+
+#if defined(__linux__)
+TBlockReader::TBlockReader(fs::path const& file, size_t iSlot) : path(file) {
+   auto eMode = eReadMode;
+   if(eMode == EReadMode::direct) {
+      handle.fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+      if(handle.fd < 0 && errno == EINVAL) eMode = EReadMode::dontneed;   // file system without O_DIRECT
+      }
+   if(eMode != EReadMode::direct) handle.fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+   if(handle.fd < 0) Raise_File_Error("cannot open file", path, errno);
+
+   struct ::stat status;
+   if(::fstat(handle.fd, &status) != 0) Raise_File_Error("cannot get file status", path, errno);
+   iSize = static_cast<std::uint64_t>(status.st_size);
+   if(eMode != EReadMode::cached && !S_ISREG(status.st_mode)) eMode = EReadMode::cached;   // pipes and devices
+   if(eMode == EReadMode::direct) {
+      buffer = Direct_Buffer(iSlot);
+      return;
+      }
+   if(eMode == EReadMode::dontneed) {
+      dropper.emplace(handle.fd, iSize);
+      ::posix_fadvise(handle.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+      }
+   else if(S_ISREG(status.st_mode) && iSize >= iMapMin && iSize <= iMapLimit) {
+      if(void* view = ::mmap(nullptr, iSize, PROT_READ, MAP_PRIVATE, handle.fd, 0); view != MAP_FAILED) {
+         mapping.view  = view;
+         mapping.iSize = static_cast<size_t>(iSize);
+         guard.emplace(view, static_cast<size_t>(iSize), PROT_READ);
+         ::madvise(view, iSize, MADV_SEQUENTIAL);
+         return;
+         }
+      }
+   buffer = Stream_Buffer(iSlot).data();
+   }
+
+TBlockReader::~TBlockReader() {
+   if(dropper && iOffset < iSize) dropper->Drop(iOffset, iSize - iOffset);   // read-ahead behind a stop of the reader
+   }
+
+void TBlockReader::Check() const {
+   if(guard) guard->Check(path);
+   }
+
+std::string_view TBlockReader::Next() {
+   if(mapping.view) {
+      Check();
+      const auto iChunk = static_cast<size_t>(std::min<std::uint64_t>(iMapChunk, mapping.iSize - iOffset));
+      const std::string_view ret(static_cast<char const*>(mapping.view) + iOffset, iChunk);
+      iOffset += iChunk;
+      return ret;
+      }
+   for(;;) {
+      const auto iRead = ::read(handle.fd, buffer, iStreamBlock);
+      if(iRead < 0) {
+         if(errno == EINTR) continue;
+         Raise_File_Error("cannot read file", path, errno);
+         }
+      if(dropper && iRead > 0) dropper->Drop(iOffset, static_cast<std::uint64_t>(iRead));
+      iOffset += static_cast<std::uint64_t>(iRead);
+      return std::string_view(buffer, static_cast<size_t>(iRead));
+      }
+   }
+#else
+TBlockReader::TBlockReader(fs::path const& file, size_t iSlot) : path(file), ifs(file, std::ios::binary), buffer(Stream_Buffer(iSlot)) {
+   if(!ifs.is_open()) Raise_File_Error("cannot open file", path, ENOENT);
+   }
+
+TBlockReader::~TBlockReader() = default;
+
+void TBlockReader::Check() const { }
+
+std::string_view TBlockReader::Next() {
+   if(!ifs) return { };
+   ifs.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+   if(ifs.bad()) Raise_File_Error("cannot read file", path, EIO);
+   return std::string_view(buffer.data(), static_cast<size_t>(ifs.gcount()));
+   }
+#endif
+
+/// call func for the content of the file block by block until func returns false, a cancelled scan throws between the blocks
+template <typename func_type>
+void Read_Blocks(fs::path const& file, func_type func) {
+   auto& control = Scan_Control();
+   TBlockReader reader(file);
+   for(auto block = reader.Next(); !block.empty(); block = reader.Next()) {
+      control.Check();
+      if(!func(block)) break;
+      }
+   reader.Check();
+   }
+
+/// UTF-16 as bytes for the counters: ASCII stays, other characters become 'x', the BOM is dropped
+class TUtf16Decoder {
+   public:
+      explicit TUtf16Decoder(bool boBigEndian) : boBig(boBigEndian) { text.reserve(iDecodeBlock); }
+
+      /// func gets the decoded text in pieces of at most iDecodeBlock bytes
+      template <typename func_type>
+      void Decode(std::string_view block, func_type&& func);
+
+   private:
+      void Unit(unsigned char first, unsigned char second) {
+         const unsigned iUnit = boBig ? (first << 8u) | second : (second << 8u) | first;
+         if(iUnit != 0xFEFFu) text.push_back(iUnit < 0x80u ? static_cast<char>(iUnit) : 'x');
+         }
+
+      bool          boBig;
+      bool          boPending = false;   // first byte of a unit at the end of the last block
+      unsigned char iPending  = 0u;
+      std::string   text;
+      static constexpr size_t iDecodeBlock = 64u * 1024u;
+   };
+
+template <typename func_type>
+void TUtf16Decoder::Decode(std::string_view block, func_type&& func) {
+   auto data = reinterpret_cast<unsigned char const*>(block.data());
+   text.clear();
+   size_t i = 0u;
+   if(boPending && !block.empty()) {
+      Unit(iPending, data[0]);
+      boPending = false;
+      i = 1u;
+      }
+   while(i + 1u < block.size()) {
+      const size_t iEnd = i + std::min((block.size() - i) & ~size_t { 1u }, 2u * (iDecodeBlock - text.size()));
+      for(; i < iEnd; i += 2u) Unit(data[i], data[i + 1u]);
+      if(text.size() >= iDecodeBlock) {
+         func(std::string_view(text));
+         text.clear();
+         }
+      }
+   if(i < block.size()) {
+      iPending  = data[i];
+      boPending = true;
+      }
+   if(!text.empty()) func(std::string_view(text));
+   }
+
+bool Is_UTF16(EContentKind eKind) {
+   return eKind == EContentKind::utf16le || eKind == EContentKind::utf16be;
+   }
+
+} // end of anonymous namespace
+
+
+/// the content isn't read after the sniff, the file has 0 rows
+bool Is_Skipped(EContentKind eKind, EBinaryPolicy ePolicy) {
+   if(eKind == EContentKind::binary || eKind == EContentKind::form_binary) return ePolicy != EBinaryPolicy::count;
+   return Is_UTF16(eKind) && ePolicy == EBinaryPolicy::skip;
+   }
+
+bool Is_Decoded(EContentKind eKind, EBinaryPolicy ePolicy) {
+   return Is_UTF16(eKind) && ePolicy == EBinaryPolicy::decode;
+   }
+
+/**
+  \brief rows of the file, with a syntax the lines by kind too, iBytes gets the size of the read file content
+  \details with boInflate a compressed file is counted with its decompressed content, else
+           it's only marked as compressed. The
+           first block of the content is sniffed, a file skipped by the policy has only its
+           kind and isn't read further, except with boReadAll for a complete fingerprint.
+           The hasher gets the content of the file as it is, not decompressed or decoded,
+           text gets the wc- style statistic of the counted content in the same pass.
+*/
+TLineStats Count_File(fs::path const& file, ELineSyntax const* syntax, EBinaryPolicy ePolicy, bool boInflate,
+                      TContentHasher* hasher, TTextStats* text, bool boReadAll, std::uint64_t& iBytes) {
+   TLineStats ret;
+   std::optional<TLineStream>    classifier;
+   std::optional<TTextStream>    counter;
+   std::optional<TUtf16Decoder>  decoder;
+   std::optional<TDecompressor>  inflater;
+   if(syntax) classifier.emplace(*syntax);
+   if(text) counter.emplace();
+   bool boFirst = true, boSkipped = false;
+   auto content = [&](std::string_view block) {
+      if(boFirst) {
+         boFirst   = false;
+         ret.eKind = Sniff_Content(block);
+         boSkipped = Is_Skipped(ret.eKind, ePolicy);
+         if(Is_Decoded(ret.eKind, ePolicy)) decoder.emplace(ret.eKind == EContentKind::utf16be);
+         }
+      if(boSkipped) return;
+      ret.iBytes += block.size();
+      auto count = [&](std::string_view view) {
+         if(counter) counter->Feed(view);
+         if(classifier) classifier->Feed(view);
+         else if(!counter) ret.iRows += Count_Newlines(view);
+         };
+      if(decoder) decoder->Decode(block, count);
+      else count(block);
+      };
+
+   iBytes = 0u;
+   Read_Blocks(file, [&](std::string_view block) {
+            if(iBytes == 0u) {
+               if(const auto eFormat = Compression_Of(block); eFormat != ECompression::none) {
+                  ret.boCompressed = true;
+                  if(boInflate) inflater.emplace(eFormat);
+                  }
+               }
+            if(!boSkipped) {
+               if(inflater) inflater->Feed(block, content);
+               else content(block);
+               }
+            if(boSkipped && !boReadAll) {
+               iBytes += inflater ? block.size() : std::min(block.size(), iSniffSize);
+               return false;
+               }
+            iBytes += block.size();
+            if(hasher) hasher->Update(block);
+            return true;
+            });
+   if(text) *text = TTextStats { };
+   if(boSkipped) return TLineStats { 0u, 0u, 0u, 0u, 0u, ret.eKind, 0u, ret.boCompressed };
+   if(inflater) inflater->Finish();
+   if(counter) {
+      *text = counter->Finish();
+      text->iBytes = ret.iBytes;
+      ret.iRows    = text->iLines;
+      }
+   if(classifier) {
+      const auto eKind = ret.eKind;
+      const auto iContent = ret.iBytes;
+      const bool boCompressed = ret.boCompressed;
+      ret = classifier->Finish();
+      ret.eKind  = eKind;
+      ret.iBytes = iContent;
+      ret.boCompressed = boCompressed;
+      }
+   return ret;
+   }
+
+
+/// content of two files of the same size compared with the content reader in the read mode of the scan, false when one can't be read
+bool Same_Content(fs::path const& lhs, fs::path const& rhs) {
+   try {
+      TBlockReader first(lhs, 0u), second(rhs, 1u);
+      std::string_view left, right;
+      for(;;) {
+         if(Scan_Control().Cancelled()) return false;
+         if(left.empty()) left = first.Next();
+         if(right.empty()) right = second.Next();
+         if(left.empty() || right.empty()) return left.empty() && right.empty();
+         const size_t iCompare = std::min(left.size(), right.size());
+         if(std::memcmp(left.data(), right.data(), iCompare) != 0) return false;
+         left.remove_prefix(iCompare);
+         right.remove_prefix(iCompare);
+         }
+      }
+   catch(fs::filesystem_error const&) {
+      return false;
+      }
+   }
+
+
+/// files above this size are read with the streaming buffer instead of being mapped
+void Set_Map_Limit(size_t iBytes) {
+   iMapLimit = iBytes;
+   }
+
+/// use of the page cache by the content readers, for the following calls; only linux knows other modes than cached
+void Set_Read_Mode(EReadMode eMode) {
+   eReadMode = eMode;
+   }
+
+EReadMode Get_Read_Mode() {
+   return eReadMode;
+   }
+
+/// bytes of the files in the page cache (mincore), to measure the footprint of a scan; 0 without linux
+std::uint64_t Resident_Bytes(std::vector<fs::path> const& files) {
+   std::uint64_t ret = 0u;
+#if defined(__linux__)
+   const auto iPage = static_cast<size_t>(::sysconf(_SC_PAGESIZE));
+   std::vector<unsigned char> resident;
+   for(auto const& file : files) {
+      const int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+      if(fd < 0) continue;
+      struct ::stat status;
+      if(::fstat(fd, &status) == 0 && S_ISREG(status.st_mode) && status.st_size > 0) {
+         const auto iSize = static_cast<size_t>(status.st_size);
+         if(void* view = ::mmap(nullptr, iSize, PROT_READ, MAP_SHARED, fd, 0); view != MAP_FAILED) {
+            resident.resize((iSize + iPage - 1u) / iPage);
+            if(::mincore(view, iSize, resident.data()) == 0) {
+               for(size_t i = 0u; i < resident.size(); ++i) {
+                  if(resident[i] & 1u) ret += std::min<std::uint64_t>(iPage, iSize - i * iPage);
+                  }
+               }
+            ::munmap(view, iSize);
+            }
+         }
+      ::close(fd);
+      }
+#else
+   static_cast<void>(files);
+#endif
+   return ret;
+   }
+
+/**
+  \brief kind of the content from its first bytes (up to 4 KB are used)
+  \details "TPF0" is a binary form. UTF-16 is found by its BOM or, as text is mostly
+           ASCII, by NUL bytes at nearly all odd (little endian) or even (big endian)
+           positions. Other NUL bytes or more than 10% control bytes are binary.
+*/
+EContentKind Sniff_Content(std::string_view head) {
+   head = head.substr(0u, iSniffSize);
+   auto data = reinterpret_cast<unsigned char const*>(head.data());
+   if(head.substr(0u, 4u) == "TPF0") return EContentKind::form_binary;
+   if(head.size() >= 2u) {
+      if(data[0] == 0xFFu && data[1] == 0xFEu) return EContentKind::utf16le;
+      if(data[0] == 0xFEu && data[1] == 0xFFu) return EContentKind::utf16be;
+      }
+
+   size_t iZeroEven = 0u, iZeroOdd = 0u, iControl = 0u;
+   for(size_t i = 0u; i < head.size(); ++i) {
+      const auto c = data[i];
+      if(c == 0u) ++(i & 1u ? iZeroOdd : iZeroEven);
+      else if(c < 0x20u && c != '\t' && c != '\n' && c != '\r' && c != '\f' && c != '\v' && c != 0x1Au && c != 0x1Bu) ++iControl;
+      }
+   if(iZeroEven + iZeroOdd == 0u) return iControl * 10u > head.size() ? EContentKind::binary : EContentKind::text;
+
+   const size_t iUnits = head.size() / 2u;
+   if(iZeroOdd * 4u >= iUnits * 3u && iZeroEven * 20u <= iUnits) return EContentKind::utf16le;
+   if(iZeroEven * 4u >= iUnits * 3u && iZeroOdd * 20u <= iUnits) return EContentKind::utf16be;
+   return EContentKind::binary;
+   }
+
+/// handling of binary and UTF-16 files in the row counters, decode is the default
+void Set_Binary_Policy(EBinaryPolicy ePolicy) {
+   eBinaryPolicy = ePolicy;
+   }
+
+EBinaryPolicy Get_Binary_Policy() {
+   return eBinaryPolicy;
+   }
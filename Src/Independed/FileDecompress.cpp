@@ -0,0 +1,181 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include "FileUtil.h"
+#include "FileUtilInternal.h"
+
+#include <algorithm>
+#include <cctype>
+#include <string>
+#include <vector>
+#include <memory>
+#include <stdexcept>
+
+// the decompressors are opt-in, the build defines them together with the libraries
+#if defined(FILEAPP_WITH_ZLIB)
+   #include <zlib.h>
+#endif
+#if defined(FILEAPP_WITH_ZSTD)
+   #include <zstd.h>
+#endif
+//---------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+// decompression of gzip (zlib) and zstd (libzstd) for the content reader,
+// through a window of fixed size, so the counters never see more than one
+// window. The decompressors are only built with FILEAPP_WITH_ZLIB and
+// FILEAPP_WITH_ZSTD, without them no content is recognized as compressed.
+namespace {
+
+const size_t iInflateBlock   = 256u * 1024u;
+bool         boDecompression = false;
+
+/// window for the decompressed content, reused for all files of the thread
+std::vector<char>& Inflate_Buffer() {
+   thread_local std::vector<char> buffer(iInflateBlock);
+   return buffer;
+   }
+
+} // end of anonymous namespace
+
+
+/// format from the magic number at the start of the file, only formats with a decompressor
+ECompression Compression_Of(std::string_view head) {
+   auto data = reinterpret_cast<unsigned char const*>(head.data());
+#if defined(FILEAPP_WITH_ZLIB)
+   if(head.size() >= 2u && data[0] == 0x1Fu && data[1] == 0x8Bu) return ECompression::gzip;
+#endif
+#if defined(FILEAPP_WITH_ZSTD)
+   if(head.size() >= 4u && data[0] == 0x28u && data[1] == 0xB5u && data[2] == 0x2Fu && data[3] == 0xFDu) return ECompression::zstd;
+#endif
+   static_cast<void>(data);
+   return ECompression::none;
+   }
+
+struct TDecompressor::TImpl {
+   explicit TImpl(ECompression eFormat);
+   TImpl(TImpl const&) = delete;
+   ~TImpl();
+
+   void Feed(std::string_view block, Window_Func const& func);
+
+   ECompression eCompression;
+   bool         boEnd = true;     // no open member or frame
+#if defined(FILEAPP_WITH_ZLIB)
+   z_stream     zs { };
+#endif
+#if defined(FILEAPP_WITH_ZSTD)
+   ZSTD_DCtx*   zctx = nullptr;
+#endif
+   };
+
+TDecompressor::TImpl::TImpl(ECompression eFormat) : eCompression(eFormat) {
+#if defined(FILEAPP_WITH_ZLIB)
+   if(eCompression == ECompression::gzip && ::inflateInit2(&zs, 15 + 32) != Z_OK)   // 32: gzip and zlib header
+      throw std::runtime_error("cannot initialize the gzip decompression");
+#endif
+#if defined(FILEAPP_WITH_ZSTD)
+   if(eCompression == ECompression::zstd && !(zctx = ::ZSTD_createDCtx()))
+      throw std::runtime_error("cannot initialize the zstd decompression");
+#endif
+   }
+
+TDecompressor::TImpl::~TImpl() {
+#if defined(FILEAPP_WITH_ZLIB)
+   if(eCompression == ECompression::gzip) ::inflateEnd(&zs);
+#endif
+#if defined(FILEAPP_WITH_ZSTD)
+   if(zctx) ::ZSTD_freeDCtx(zctx);
+#endif
+   }
+
+void TDecompressor::TImpl::Feed(std::string_view block, Window_Func const& func) {
+   auto& window = Inflate_Buffer();
+#if defined(FILEAPP_WITH_ZLIB)
+   if(eCompression == ECompression::gzip) {
+      zs.next_in  = reinterpret_cast<Bytef*>(const_cast<char*>(block.data()));
+      zs.avail_in = static_cast<uInt>(block.size());
+      for(bool boFull = false; zs.avail_in > 0u || boFull; ) {   // a full window can leave content in the stream
+         if(boEnd) {
+            if(zs.avail_in == 0u) break;
+            if(*zs.next_in == 0u) {   // padding behind the last member
+               ++zs.next_in;
+               --zs.avail_in;
+               continue;
+               }
+            ::inflateReset(&zs);
+            boEnd = false;
+            }
+         Scan_Control().Check();   // a small block can give many windows
+         zs.next_out  = reinterpret_cast<Bytef*>(window.data());
+         zs.avail_out = static_cast<uInt>(window.size());
+         const int iResult = ::inflate(&zs, Z_NO_FLUSH);
+         if(iResult != Z_OK && iResult != Z_STREAM_END && iResult != Z_BUF_ERROR)
+            throw std::runtime_error(std::string("corrupt gzip stream: ") + (zs.msg ? zs.msg : "unknown error"));
+         if(const size_t iOut = window.size() - zs.avail_out; iOut > 0u) func(std::string_view(window.data(), iOut));
+         boFull = zs.avail_out == 0u;
+         if(iResult == Z_STREAM_END) boEnd = true;
+         }
+      return;
+      }
+#endif
+#if defined(FILEAPP_WITH_ZSTD)
+   if(eCompression == ECompression::zstd) {
+      ZSTD_inBuffer input { block.data(), block.size(), 0u };
+      for(bool boFull = false; input.pos < input.size || boFull; ) {
+         Scan_Control().Check();
+         ZSTD_outBuffer output { window.data(), window.size(), 0u };
+         const size_t iResult = ::ZSTD_decompressStream(zctx, &output, &input);
+         if(::ZSTD_isError(iResult)) throw std::runtime_error(std::string("corrupt zstd stream: ") + ::ZSTD_getErrorName(iResult));
+         if(output.pos > 0u) func(std::string_view(window.data(), output.pos));
+         boFull = output.pos == output.size;
+         boEnd  = iResult == 0u;
+         }
+      return;
+      }
+#endif
+   static_cast<void>(block);
+   static_cast<void>(func);
+   static_cast<void>(window);
+   }
+
+TDecompressor::TDecompressor(ECompression eFormat) : impl(std::make_unique<TImpl>(eFormat)) { }
+
+TDecompressor::~TDecompressor() = default;
+
+void TDecompressor::Feed(std::string_view block, Window_Func const& func) {
+   impl->Feed(block, func);
+   }
+
+/// a file which ends inside of a member or frame is truncated
+void TDecompressor::Finish() const {
+   if(!impl->boEnd) throw std::runtime_error("truncated compressed stream");
+   }
+
+
+/**
+  \brief count compressed files (gzip, zstd) with their decompressed content, off by default
+  \returns false when the program is built without any decompressor, the setting is off then
+*/
+bool Set_Decompression(bool boDecompress) {
+#if defined(FILEAPP_WITH_ZLIB) || defined(FILEAPP_WITH_ZSTD)
+   boDecompression = boDecompress;
+   return true;
+#else
+   boDecompression = false;
+   return !boDecompress;
+#endif
+   }
+
+bool Get_Decompression() {
+   return boDecompression;
+   }
+
+/// name of a compressed file, the content decides in the counters
+bool Is_Compressed_Name(fs::path const& file) {
+   auto strExt = file.extension().string();
+   std::transform(strExt.begin(), strExt.end(), strExt.begin(), [](unsigned char c) { return std::tolower(c); });
+   return strExt == ".gz" || strExt == ".tgz" || strExt == ".zst" || strExt == ".tzst";
+   }
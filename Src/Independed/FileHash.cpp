@@ -0,0 +1,127 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include "FileUtil.h"
+#include "FileUtilInternal.h"
+
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+//---------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+// fingerprint of the content, 128 bit and not cryptographic. Four lanes of 64
+// bit take stripes of 32 bytes with the rounds of xxHash64; both halves of the
+// result are built from all lanes with different mixes, the rest and the length
+// go into both. The content is fed in blocks of any size, the result doesn't
+// depend on them. Values are read as little endian, as on the target systems.
+namespace {
+
+const std::uint64_t iHashPrime1 = 0x9E3779B185EBCA87u;
+const std::uint64_t iHashPrime2 = 0xC2B2AE3D27D4EB4Fu;
+const std::uint64_t iHashPrime3 = 0x165667B19E3779F9u;
+const std::uint64_t iHashPrime4 = 0x85EBCA77C2B2AE63u;
+const std::uint64_t iHashPrime5 = 0x27D4EB2F165667C5u;
+
+std::uint64_t Rotate_Left(std::uint64_t val, int bits) {
+   return (val << bits) | (val >> (64 - bits));
+   }
+
+template <typename ty>
+ty Read_Word(unsigned char const* data) {
+   ty ret;
+   std::memcpy(&ret, data, sizeof(ty));
+   return ret;
+   }
+
+std::uint64_t Hash_Round(std::uint64_t acc, std::uint64_t lane) {
+   return Rotate_Left(acc + lane * iHashPrime2, 31) * iHashPrime1;
+   }
+
+std::uint64_t Hash_Merge(std::uint64_t acc, std::uint64_t lane) {
+   return (acc ^ Hash_Round(0u, lane)) * iHashPrime1 + iHashPrime4;
+   }
+
+std::uint64_t Hash_Avalanche(std::uint64_t val) {
+   val ^= val >> 33;
+   val *= iHashPrime2;
+   val ^= val >> 29;
+   val *= iHashPrime3;
+   val ^= val >> 32;
+   return val;
+   }
+
+} // end of anonymous namespace
+
+
+TContentHasher::TContentHasher() : lanes { iHashPrime1 + iHashPrime2, iHashPrime2, 0u, 0u - iHashPrime1 } { }
+
+void TContentHasher::Stripe(unsigned char const* data) {
+   for(int i = 0; i < 4; ++i) lanes[i] = Hash_Round(lanes[i], Read_Word<std::uint64_t>(data + 8 * i));
+   }
+
+void TContentHasher::Update(std::string_view data) {
+   auto p   = reinterpret_cast<unsigned char const*>(data.data());
+   auto end = p + data.size();
+   iLength += data.size();
+   if(iBuffered > 0u) {
+      const size_t iCopy = std::min<size_t>(sizeof(buffer) - iBuffered, data.size());
+      std::memcpy(buffer + iBuffered, p, iCopy);
+      iBuffered += iCopy;
+      p         += iCopy;
+      if(iBuffered < sizeof(buffer)) return;
+      Stripe(buffer);
+      iBuffered = 0u;
+      }
+   for(; end - p >= 32; p += 32) Stripe(p);
+   iBuffered = static_cast<size_t>(end - p);
+   std::memcpy(buffer, p, iBuffered);
+   }
+
+TContentHash TContentHasher::Final() const {
+   std::uint64_t iLow, iHigh;
+   if(iLength >= sizeof(buffer)) {
+      iLow  = Rotate_Left(lanes[0], 1) + Rotate_Left(lanes[1], 7) + Rotate_Left(lanes[2], 12) + Rotate_Left(lanes[3], 18);
+      iHigh = Rotate_Left(lanes[0], 18) + Rotate_Left(lanes[1], 12) + Rotate_Left(lanes[2], 7) + Rotate_Left(lanes[3], 1);
+      for(int i = 0; i < 4; ++i) {
+         iLow  = Hash_Merge(iLow, lanes[i]);
+         iHigh = Hash_Merge(iHigh, lanes[3 - i] ^ iHashPrime3);
+         }
+      }
+   else {
+      iLow  = iHashPrime5;
+      iHigh = iHashPrime5 ^ iHashPrime2;
+      }
+   iLow  += iLength;
+   iHigh += iLength * iHashPrime3;
+
+   unsigned char const* p   = buffer;
+   unsigned char const* end = buffer + iBuffered;
+   for(; end - p >= 8; p += 8) {
+      const auto word = Read_Word<std::uint64_t>(p);
+      iLow  = Rotate_Left(iLow ^ Hash_Round(0u, word), 27) * iHashPrime1 + iHashPrime4;
+      iHigh = Rotate_Left(iHigh ^ Hash_Round(0u, word ^ iHashPrime5), 29) * iHashPrime2 + iHashPrime3;
+      }
+   if(end - p >= 4) {
+      const std::uint64_t word = Read_Word<std::uint32_t>(p);
+      iLow  = Rotate_Left(iLow ^ (word * iHashPrime1), 23) * iHashPrime2 + iHashPrime3;
+      iHigh = Rotate_Left(iHigh ^ (word * iHashPrime4), 21) * iHashPrime1 + iHashPrime5;
+      p += 4;
+      }
+   for(; p < end; ++p) {
+      iLow  = Rotate_Left(iLow ^ (*p * iHashPrime5), 11) * iHashPrime1;
+      iHigh = Rotate_Left(iHigh ^ (*p * iHashPrime1), 13) * iHashPrime5;
+      }
+   return TContentHash { Hash_Avalanche(iLow), Hash_Avalanche(iHigh ^ (iLow >> 29)) };
+   }
+
+
+/// fingerprint of the text, the same value as for a file with this content
+TContentHash Hash_Content(std::string_view text) {
+   TContentHasher hasher;
+   hasher.Update(text);
+   return hasher.Final();
+   }
+
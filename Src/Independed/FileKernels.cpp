@@ -0,0 +1,1345 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include "FileUtil.h"
+#include "FileUtilInternal.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <cstdint>
+#include <memory>
+
+#if defined(__x86_64__) || defined(_M_X64)
+   #include <immintrin.h>
+   #if defined(_MSC_VER) && !defined(__clang__)
+      #include <intrin.h>
+      #define FILEAPP_TARGET(features)
+   #else
+      #include <cpuid.h>
+      #define FILEAPP_TARGET(features) __attribute__((target(features)))
+   #endif
+   #define FILEAPP_HAS_X86_SIMD
+#endif
+//---------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+// counting of rows, newlines are counted with the widest vector unit of the
+// processor (AVX-512BW, AVX2, SSE2), selected once at runtime with cpuid. The
+// comparison gives -1 for every '\n', the bytes are summed in 8 bit counters
+// for at most 255 rounds and then added to 64 bit counters with sad.
+namespace {
+
+size_t Count_Newlines_Scalar(char const* data, size_t size) {
+   return static_cast<size_t>(std::count(data, data + size, '\n'));
+   }
+
+#if defined(FILEAPP_HAS_X86_SIMD)
+
+struct TCpuFeatures {
+   bool boSSE2     = false;
+   bool boAVX2     = false;
+   bool boAVX512BW = false;
+   };
+
+void Cpu_Id(unsigned leaf, unsigned subleaf, unsigned regs[4]) {
+#if defined(_MSC_VER) && !defined(__clang__)
+   int values[4];
+   __cpuidex(values, static_cast<int>(leaf), static_cast<int>(subleaf));
+   for(int i = 0; i < 4; ++i) regs[i] = static_cast<unsigned>(values[i]);
+#else
+   __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+   }
+
+/// registers saved by the operating system, without support the wide units can't be used
+std::uint64_t Xcr0() {
+#if defined(_MSC_VER) && !defined(__clang__)
+   return _xgetbv(0);
+#else
+   unsigned eax, edx;
+   __asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0u));
+   return (static_cast<std::uint64_t>(edx) << 32) | eax;
+#endif
+   }
+
+TCpuFeatures Detect_Cpu() {
+   TCpuFeatures ret;
+   unsigned regs[4];
+   Cpu_Id(0u, 0u, regs);
+   const unsigned iMaxLeaf = regs[0];
+   Cpu_Id(1u, 0u, regs);
+   ret.boSSE2 = (regs[3] & (1u << 26)) != 0u;
+   const bool boOSXSave = (regs[2] & (1u << 27)) != 0u;
+   if(!boOSXSave || iMaxLeaf < 7u) return ret;
+   const auto xcr0 = Xcr0();
+   const bool boYmm = (xcr0 & 0x06u) == 0x06u;          // xmm and ymm state
+   const bool boZmm = boYmm && (xcr0 & 0xe0u) == 0xe0u;  // opmask and zmm state
+   Cpu_Id(7u, 0u, regs);
+   ret.boAVX2     = boYmm && (regs[1] & (1u << 5)) != 0u;
+   ret.boAVX512BW = boZmm && (regs[1] & (1u << 16)) != 0u && (regs[1] & (1u << 30)) != 0u;   // F and BW
+   return ret;
+   }
+
+TCpuFeatures const& Cpu_Features() {
+   static const TCpuFeatures features = Detect_Cpu();
+   return features;
+   }
+
+FILEAPP_TARGET("sse2")
+size_t Count_Newlines_SSE2(char const* data, size_t size) {
+   const __m128i newline = _mm_set1_epi8('\n');
+   const __m128i zero    = _mm_setzero_si128();
+   __m128i sums = _mm_setzero_si128();
+   size_t pos = 0u;
+   while(size - pos >= 16u) {
+      const size_t iRounds = std::min<size_t>((size - pos) / 16u, 255u);
+      __m128i counts = _mm_setzero_si128();
+      for(size_t i = 0u; i < iRounds; ++i, pos += 16u) {
+         const __m128i block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + pos));
+         counts = _mm_sub_epi8(counts, _mm_cmpeq_epi8(block, newline));
+         }
+      sums = _mm_add_epi64(sums, _mm_sad_epu8(counts, zero));
+      }
+   alignas(16) std::uint64_t lanes[2];
+   _mm_store_si128(reinterpret_cast<__m128i*>(lanes), sums);
+   return static_cast<size_t>(lanes[0] + lanes[1]) + Count_Newlines_Scalar(data + pos, size - pos);
+   }
+
+/// four independent counters, the loads of the next blocks don't wait for the additions
+FILEAPP_TARGET("avx2")
+size_t Count_Newlines_AVX2(char const* data, size_t size) {
+   const __m256i newline = _mm256_set1_epi8('\n');
+   const __m256i zero    = _mm256_setzero_si256();
+   __m256i sums = _mm256_setzero_si256();
+   size_t pos = 0u;
+   while(size - pos >= 128u) {
+      const size_t iRounds = std::min<size_t>((size - pos) / 128u, 255u);
+      __m256i counts[4] = { zero, zero, zero, zero };
+      for(size_t i = 0u; i < iRounds; ++i, pos += 128u) {
+         for(int j = 0; j < 4; ++j) {
+            const __m256i block = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + pos + 32u * j));
+            counts[j] = _mm256_sub_epi8(counts[j], _mm256_cmpeq_epi8(block, newline));
+            }
+         }
+      for(int j = 0; j < 4; ++j) sums = _mm256_add_epi64(sums, _mm256_sad_epu8(counts[j], zero));
+      }
+   alignas(32) std::uint64_t lanes[4];
+   _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), sums);
+   return static_cast<size_t>(lanes[0] + lanes[1] + lanes[2] + lanes[3]) + Count_Newlines_SSE2(data + pos, size - pos);
+   }
+
+FILEAPP_TARGET("avx512f,avx512bw")
+size_t Count_Newlines_AVX512(char const* data, size_t size) {
+   const __m512i newline = _mm512_set1_epi8('\n');
+   const __m512i zero    = _mm512_setzero_si512();
+   __m512i sums = _mm512_setzero_si512();
+   size_t pos = 0u;
+   while(size - pos >= 128u) {
+      const size_t iRounds = std::min<size_t>((size - pos) / 128u, 255u);
+      __m512i counts[2] = { zero, zero };
+      for(size_t i = 0u; i < iRounds; ++i, pos += 128u) {
+         for(int j = 0; j < 2; ++j) {
+            const __m512i block = _mm512_loadu_si512(data + pos + 64u * j);
+            counts[j] = _mm512_sub_epi8(counts[j], _mm512_movm_epi8(_mm512_cmpeq_epi8_mask(block, newline)));
+            }
+         }
+      for(int j = 0; j < 2; ++j) sums = _mm512_add_epi64(sums, _mm512_sad_epu8(counts[j], zero));
+      }
+   // rest with a masked load, no access behind the end of the data
+   if(pos < size) {
+      const __mmask64 mask = _cvtu64_mask64(~std::uint64_t { 0u } >> (64u - std::min<size_t>(size - pos, 64u)));
+      const __m512i block = _mm512_maskz_loadu_epi8(mask, data + pos);
+      sums = _mm512_add_epi64(sums, _mm512_sad_epu8(_mm512_sub_epi8(zero, _mm512_movm_epi8(_mm512_mask_cmpeq_epi8_mask(mask, block, newline))), zero));
+      pos += std::min<size_t>(size - pos, 64u);
+      }
+   alignas(64) std::uint64_t lanes[8];
+   _mm512_store_si512(lanes, sums);
+   std::uint64_t iSum = 0u;
+   for(auto lane : lanes) iSum += lane;
+   return static_cast<size_t>(iSum) + Count_Newlines_SSE2(data + pos, size - pos);
+   }
+
+#endif
+
+using Count_Newlines_Func = size_t (*)(char const*, size_t);
+
+Count_Newlines_Func Row_Kernel_Func(ERowKernel eKernel) {
+   switch(eKernel) {
+#if defined(FILEAPP_HAS_X86_SIMD)
+      case ERowKernel::sse2:   return Count_Newlines_SSE2;
+      case ERowKernel::avx2:   return Count_Newlines_AVX2;
+      case ERowKernel::avx512: return Count_Newlines_AVX512;
+#endif
+      default:                 return Count_Newlines_Scalar;
+      }
+   }
+
+bool Row_Kernel_Supported(ERowKernel eKernel) {
+#if defined(FILEAPP_HAS_X86_SIMD)
+   auto const& cpu = Cpu_Features();
+   switch(eKernel) {
+      case ERowKernel::scalar: return true;
+      case ERowKernel::sse2:   return cpu.boSSE2;
+      case ERowKernel::avx2:   return cpu.boAVX2;
+      case ERowKernel::avx512: return cpu.boAVX512BW;
+      }
+   return false;
+#else
+   return eKernel == ERowKernel::scalar;
+#endif
+   }
+
+ERowKernel Best_Row_Kernel() {
+   for(auto eKernel : { ERowKernel::avx512, ERowKernel::avx2, ERowKernel::sse2 })
+      if(Row_Kernel_Supported(eKernel)) return eKernel;
+   return ERowKernel::scalar;
+   }
+
+ERowKernel          eRowKernel       = Best_Row_Kernel();
+Count_Newlines_Func count_newlines   = Row_Kernel_Func(eRowKernel);
+
+} // end of anonymous namespace
+
+
+/// select the kernel for Count_Newlines(), false if the processor doesn't support it
+bool Set_Row_Kernel(ERowKernel eKernel) {
+   if(!Row_Kernel_Supported(eKernel)) return false;
+   eRowKernel     = eKernel;
+   count_newlines = Row_Kernel_Func(eKernel);
+   return true;
+   }
+
+ERowKernel Get_Row_Kernel() {
+   return eRowKernel;
+   }
+
+size_t Count_Newlines(std::string_view text) {
+   return count_newlines(text.data(), text.size());
+   }
+
+
+
+//----------------------------------------------------------------------------
+// classification of lines, one pass over the content with the state of a
+// small lexer (code, comments, string, character and raw string literals).
+// For chunks of blocks of 64 bytes the positions of the bytes which matter are
+// marked in bit masks (newline, not blank, "//", '#', the pairs which start a
+// block comment or a raw string, backslash and "*/"), built with SSE2, AVX2 or
+// AVX-512. The lines of plain code, line comments, directives and inside of
+// block comments are counted from these masks in the same loop which builds
+// them, for all lines of a block at once; lines which open or close a block
+// comment alone, and directives without quotes, are classified from the masks
+// too. The masks of quotes, stars, backslashes and parenthesis are built only
+// for the blocks of the other lines, there the lexer jumps from one marked byte
+// to the next which is relevant in its state, the other bytes aren't touched.
+// The content is processed in complete lines, the rest of a block waits for the
+// next one, so the lexer sees every line whole. The next chunk is prefetched
+// while the masks are built, the hardware doesn't prefetch over a page end.
+namespace {
+
+bool Is_Blank(char c) {
+   return c == ' ' || c == '\t' || c == '\r' || c == '\f' || c == '\v';
+   }
+
+bool Is_Identifier(char c) {
+   return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+   }
+
+bool Is_Hex_Digit(char c) {
+   return std::isxdigit(static_cast<unsigned char>(c)) != 0;
+   }
+
+int Lowest_Bit(std::uint64_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+   unsigned long idx;
+   _BitScanForward64(&idx, mask);
+   return static_cast<int>(idx);
+#else
+   return __builtin_ctzll(mask);
+#endif
+   }
+
+/// marked positions of a block of 64 bytes, bit i for the byte i, pairs are marked at their first byte
+struct TLineMasks {
+   std::uint64_t iNewline   = 0u;
+   std::uint64_t iContent   = 0u;   // neither blank nor newline
+   std::uint64_t iComment   = 0u;   // "//"
+   std::uint64_t iHash      = 0u;   // '#'
+   std::uint64_t iOpen      = 0u;   // "/*", "R\"" and '\\', a line with them in code is for the lexer
+   std::uint64_t iClose     = 0u;   // "*/", the same in a block comment
+   // for the lexer, built for a block when it walks there
+   std::uint64_t iQuote     = 0u;   // '"', '\'' and '/'
+   std::uint64_t iStar      = 0u;
+   std::uint64_t iBackslash = 0u;
+   std::uint64_t iParen     = 0u;   // ')'
+   };
+
+/// the masks of the fast path for a block, the others aren't touched
+void Core_Masks(TLineMasks& masks, std::uint64_t const (&iMasks)[6]) {
+   masks.iNewline = iMasks[0];
+   masks.iContent = iMasks[1];
+   masks.iComment = iMasks[2];
+   masks.iHash    = iMasks[3];
+   masks.iOpen    = iMasks[4];
+   masks.iClose   = iMasks[5];
+   }
+
+/// the masks of the lexer for a block
+void Extra_Masks(TLineMasks& masks, std::uint64_t const (&iMasks)[4]) {
+   masks.iQuote     = iMasks[0];
+   masks.iStar      = iMasks[1];
+   masks.iBackslash = iMasks[2];
+   masks.iParen     = iMasks[3];
+   }
+
+const size_t iLineChunk = 64u;   // blocks of 64 bytes for one call of the mask kernels
+
+// the hardware prefetch doesn't go over the end of a page, the mask kernels touch the content
+// this far ahead of the block (a prefetch never faults, also behind the end of the content)
+const size_t iLinePrefetch = 4096u;
+
+// an unfinished line longer than iLongLine is walked in place up to its last iLineAhead bytes
+// (the longest look ahead is a raw string delimiter), only them and iLineBehind bytes before
+// (for continuations and the prefix of a raw string) are kept for the next block
+const size_t iLongLine   = 64u * 1024u;
+const size_t iLineAhead  = 64u;
+const size_t iLineBehind = 8u;
+
+/// the masks of a chunk of the content, those of the lexer are built for a block when they're needed
+struct TLineChunk {
+   char const*   data    = nullptr;
+   size_t        iBlocks = 0u;
+   size_t        iDirect = 0u;   // blocks in place, the last one else is copied with blanks behind the end
+   std::uint64_t iExtra  = 0u;   // blocks with the masks of the lexer
+   TLineMasks    masks[iLineChunk];
+   char          padded[128];
+
+   /// the bytes of the block b, the masks look one byte behind it
+   char const* Block(size_t b) const { return b < iDirect ? data + 64u * b : padded; }
+   };
+
+/// count of set bits, inline without the popcnt instruction, which isn't part of the base x86-64
+int Bit_Count(std::uint64_t mask) {
+   mask = mask - ((mask >> 1) & 0x5555555555555555u);
+   mask = (mask & 0x3333333333333333u) + ((mask >> 2) & 0x3333333333333333u);
+   mask = (mask + (mask >> 4)) & 0x0F0F0F0F0F0F0F0Fu;
+   return static_cast<int>((mask * 0x0101010101010101u) >> 56);
+   }
+
+#if defined(FILEAPP_HAS_X86_SIMD)
+/// the popcnt instruction, inline in the functions for a target with it
+int Bit_Count_POPCNT(std::uint64_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+   return static_cast<int>(__popcnt64(mask));
+#else
+   return __builtin_popcountll(mask);
+#endif
+   }
+#endif
+
+int Highest_Bit(std::uint64_t mask) {
+#if defined(_MSC_VER) && !defined(__clang__)
+   unsigned long idx;
+   _BitScanReverse64(&idx, mask);
+   return static_cast<int>(idx);
+#else
+   return 63 - __builtin_clzll(mask);
+#endif
+   }
+
+/// a + b + carry, the carry out of the highest bit is given back in carry
+std::uint64_t Add_Carry(std::uint64_t a, std::uint64_t b, std::uint64_t& carry) {
+#if defined(FILEAPP_HAS_X86_SIMD)
+   unsigned long long ret;
+   carry = _addcarry_u64(static_cast<unsigned char>(carry), a, b, &ret);
+   return ret;
+#else
+   const std::uint64_t sum = a + b;
+   const std::uint64_t ret = sum + carry;
+   carry = static_cast<std::uint64_t>(sum < a) | static_cast<std::uint64_t>(ret < sum);
+   return ret;
+#endif
+   }
+
+/// position of the first mark in field from iFrom on, iTo when there is none before iTo
+size_t Next_Mark(TLineMasks const* masks, std::uint64_t TLineMasks::* field, size_t iFrom, size_t iTo) {
+   for(size_t b = iFrom / 64u; 64u * b < iTo; ++b) {
+      const std::uint64_t iMarks = masks[b].*field & (~std::uint64_t { 0u } << (b == iFrom / 64u ? iFrom % 64u : 0u));
+      if(iMarks != 0u) return std::min(iTo, 64u * b + Lowest_Bit(iMarks));
+      }
+   return iTo;
+   }
+
+/// counted lines of the fast path, from a fresh line in code or in a block comment
+struct TPlainLines {
+   bool          boBlock     = false;   // in a block comment
+   std::uint64_t iStart      = 1u;      // 0 when the last line has content
+   size_t        iBlank      = 0u;
+   size_t        iText       = 0u;      // lines with content, counted at their first content
+   size_t        iLines      = 0u;      // of them comments in a block comment, comment lines else
+   size_t        iDirectives = 0u;
+   bool          boLexer     = false;   // stopped at a line for the lexer
+   };
+
+/**
+  \brief the fast path, lines from the masks alone, for all lines of a block at once
+  \details the first byte with content or the newline of a line is the first bit of
+           content | newline from the begin of the line on, found with the carry of an
+           addition over the bits between, the line is counted there by its kind. A line
+           with a mark of iOpen (in code) or iClose (in a block comment) stops the fast path,
+           the lines before it are counted. The mask kernels call Block() for each block
+           when they have built its masks, so it runs beside them
+*/
+template <int (*count)(std::uint64_t)>
+class TPlainCount {
+   public:
+      TPlainCount(TPlainLines const* lines, size_t iOffset) :
+         boRun(lines != nullptr), iFirst(iOffset / 64u),
+         iCode(lines && lines->boBlock ? 0u : ~std::uint64_t { 0u }),
+         iFrom(~std::uint64_t { 0u } << (iOffset % 64u)),
+         iStart(std::uint64_t { 1u } << (iOffset % 64u)) { }
+
+      bool Running() const { return boRun; }
+
+      void Block(TLineMasks const& block, size_t b) {
+         if(!boRun || b < iFirst) return;
+         std::uint64_t iNewline = block.iNewline & iFrom;
+         std::uint64_t iContent = block.iContent & iFrom;
+         if(const std::uint64_t iStop = ((block.iOpen & iCode) | (block.iClose & ~iCode)) & iFrom; iStop != 0u) {
+            const std::uint64_t iBefore = iNewline & ((iStop & (0u - iStop)) - 1u);
+            boRun   = false;
+            boLexer = true;
+            if(iBefore == 0u) {
+               iEnd = 64u * b;
+               return;
+               }
+            const std::uint64_t iKeep = ~std::uint64_t { 0u } >> (63 - Highest_Bit(iBefore));
+            iNewline &= iKeep;
+            iContent &= iKeep;
+            iEnd = 64u * b + Highest_Bit(iBefore) + 1u;
+            }
+         const std::uint64_t iMarked = iContent | iNewline;
+         std::uint64_t carry = 0u;
+         const std::uint64_t iLine  = Add_Carry((iNewline << 1) | iStart, ~iMarked, carry) & iMarked;
+         const std::uint64_t iText  = iLine & iContent;
+         iCount[0] += count(iLine & iNewline);
+         iCount[1] += count(iText);
+         iCount[2] += count(iText & (block.iComment | ~iCode));
+         iCount[3] += count(iText & block.iHash & iCode);
+         iStart = carry | (iNewline >> 63);
+         iFrom  = ~std::uint64_t { 0u };
+         }
+
+      /// the counts to lines, returns the end of the counted bits, the last line there isn't
+      /// finished and is taken back by the caller when it has content
+      size_t Store(TPlainLines* lines, size_t iBlocks) const {
+         if(!lines) return 0u;
+         lines->iStart      = iStart;
+         lines->iBlank      = iCount[0];
+         lines->iText       = iCount[1];
+         lines->iLines      = iCount[2];
+         lines->iDirectives = iCount[3];
+         lines->boLexer     = boLexer;
+         return boLexer ? iEnd : 64u * iBlocks;
+         }
+
+   private:
+      bool          boRun;
+      bool          boLexer   = false;
+      size_t        iFirst;
+      std::uint64_t iCode;
+      std::uint64_t iFrom;
+      std::uint64_t iStart;
+      size_t        iCount[4] = { };   // blank, text, comments, directives
+      size_t        iEnd      = 0u;
+   };
+
+/// the fast path alone over the masks of the chunk from iOffset on
+template <int (*count)(std::uint64_t)>
+size_t Plain_Blocks(TLineChunk const& chunk, size_t iOffset, TPlainLines& lines) {
+   TPlainCount<count> plain(&lines, iOffset);
+   for(size_t b = iOffset / 64u; b < chunk.iBlocks && plain.Running(); ++b) plain.Block(chunk.masks[b], b);
+   return plain.Store(&lines, chunk.iBlocks);
+   }
+
+/**
+  \brief the masks of the blocks of the chunk, and the fast path from iOffset on when lines is given
+  \details the pairs look one byte behind the block, the byte behind the last direct block must
+           be readable. Returns the end of the counted bits (see TPlainCount::Store())
+*/
+size_t Line_Masks_Scalar(TLineChunk& chunk, size_t iOffset, TPlainLines* lines) {
+   TPlainCount<Bit_Count> plain(lines, iOffset);
+   for(size_t b = 0u; b < chunk.iBlocks; ++b) {
+      char const*   data      = chunk.Block(b);
+      std::uint64_t iMasks[6] = { };
+      for(int i = 0; i < 64; ++i) {
+         const std::uint64_t bit = std::uint64_t { 1u } << i;
+         const char c = data[i];
+         const char n = data[i + 1];
+         if(c == '\n') iMasks[0] |= bit;
+         else if(!Is_Blank(c)) iMasks[1] |= bit;
+         if(c == '/' && n == '/') iMasks[2] |= bit;
+         if(c == '#') iMasks[3] |= bit;
+         if((c == '/' && n == '*') || (c == 'R' && n == '"') || c == '\\') iMasks[4] |= bit;
+         if(c == '*' && n == '/') iMasks[5] |= bit;
+         }
+      Core_Masks(chunk.masks[b], iMasks);
+      plain.Block(chunk.masks[b], b);
+      }
+   return plain.Store(lines, chunk.iBlocks);
+   }
+
+void Line_Extra_Scalar(char const* data, size_t iBlocks, TLineMasks* masks) {
+   for(size_t b = 0u; b < iBlocks; ++b, data += 64) {
+      std::uint64_t iMasks[4] = { };
+      for(int i = 0; i < 64; ++i) {
+         const std::uint64_t bit = std::uint64_t { 1u } << i;
+         if(data[i] == '"' || data[i] == '\'' || data[i] == '/') iMasks[0] |= bit;
+         if(data[i] == '*')  iMasks[1] |= bit;
+         if(data[i] == '\\') iMasks[2] |= bit;
+         if(data[i] == ')')  iMasks[3] |= bit;
+         }
+      Extra_Masks(masks[b], iMasks);
+      }
+   }
+
+size_t Plain_Blocks_Scalar(TLineChunk const& chunk, size_t iOffset, TPlainLines& lines) {
+   return Plain_Blocks<Bit_Count>(chunk, iOffset, lines);
+   }
+
+#if defined(FILEAPP_HAS_X86_SIMD)
+FILEAPP_TARGET("sse2")
+std::uint64_t Mask_SSE2(__m128i val) {
+   return static_cast<std::uint64_t>(static_cast<unsigned>(_mm_movemask_epi8(val)) & 0xffffu);
+   }
+
+/// the masks of 16 bytes at data, or'ed in at iShift
+FILEAPP_TARGET("sse2")
+inline void Part_Masks_SSE2(char const* data, std::uint64_t (&iMasks)[6], unsigned iShift) {
+   const __m128i block   = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data));
+   const __m128i next    = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + 1));
+   const __m128i newline = _mm_cmpeq_epi8(block, _mm_set1_epi8('\n'));
+   // blank and newline: ' ' and '\t' .. '\r'
+   const __m128i blank   = _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8(' ')),
+                                        _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8(8)),
+                                                      _mm_cmplt_epi8(block, _mm_set1_epi8(14))));
+   const __m128i slash   = _mm_cmpeq_epi8(block, _mm_set1_epi8('/'));
+   const __m128i after   = _mm_cmpeq_epi8(next, _mm_set1_epi8('/'));
+   const __m128i open    = _mm_or_si128(_mm_or_si128(_mm_and_si128(slash, _mm_cmpeq_epi8(next, _mm_set1_epi8('*'))),
+                                                     _mm_and_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('R')),
+                                                                   _mm_cmpeq_epi8(next, _mm_set1_epi8('"')))),
+                                        _mm_cmpeq_epi8(block, _mm_set1_epi8('\\')));
+   iMasks[0] |= Mask_SSE2(newline) << iShift;
+   iMasks[1] |= (Mask_SSE2(blank) ^ 0xffffu) << iShift;
+   iMasks[2] |= Mask_SSE2(_mm_and_si128(slash, after)) << iShift;
+   iMasks[3] |= Mask_SSE2(_mm_cmpeq_epi8(block, _mm_set1_epi8('#'))) << iShift;
+   iMasks[4] |= Mask_SSE2(open) << iShift;
+   iMasks[5] |= Mask_SSE2(_mm_and_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('*')), after)) << iShift;
+   }
+
+FILEAPP_TARGET("sse2")
+size_t Line_Masks_SSE2(TLineChunk& chunk, size_t iOffset, TPlainLines* lines) {
+   TPlainCount<Bit_Count> plain(lines, iOffset);
+   for(size_t b = 0u; b < chunk.iBlocks; ++b) {
+      char const* data = chunk.Block(b);
+      _mm_prefetch(data + iLinePrefetch, _MM_HINT_T0);
+      std::uint64_t iMasks[6] = { };
+      Part_Masks_SSE2(data, iMasks, 0u);
+      Part_Masks_SSE2(data + 16, iMasks, 16u);
+      Part_Masks_SSE2(data + 32, iMasks, 32u);
+      Part_Masks_SSE2(data + 48, iMasks, 48u);
+      Core_Masks(chunk.masks[b], iMasks);
+      plain.Block(chunk.masks[b], b);
+      }
+   return plain.Store(lines, chunk.iBlocks);
+   }
+
+FILEAPP_TARGET("sse2")
+void Line_Extra_SSE2(char const* data, size_t iBlocks, TLineMasks* masks) {
+   for(size_t b = 0u; b < iBlocks; ++b, data += 64) {
+      std::uint64_t iMasks[4] = { };
+      for(int i = 0; i < 4; ++i) {
+         const __m128i block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + 16 * i));
+         const __m128i quote = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8('"')),
+                                                         _mm_cmpeq_epi8(block, _mm_set1_epi8('\''))),
+                                            _mm_cmpeq_epi8(block, _mm_set1_epi8('/')));
+         iMasks[0] |= Mask_SSE2(quote) << (16 * i);
+         iMasks[1] |= Mask_SSE2(_mm_cmpeq_epi8(block, _mm_set1_epi8('*'))) << (16 * i);
+         iMasks[2] |= Mask_SSE2(_mm_cmpeq_epi8(block, _mm_set1_epi8('\\'))) << (16 * i);
+         iMasks[3] |= Mask_SSE2(_mm_cmpeq_epi8(block, _mm_set1_epi8(')'))) << (16 * i);
+         }
+      Extra_Masks(masks[b], iMasks);
+      }
+   }
+
+// blank and newline for a shuffle with the low half of the byte: ' ', '\t' .. '\r', for each
+// 16 bytes of a register. A value with another low half doesn't match, bytes from 0x80 give 0
+alignas(64) const char cBlankTable[64] = {
+   ' ', -128, -128, -128, -128, -128, -128, -128, -128, 9, 10, 11, 12, 13, -128, -128,
+   ' ', -128, -128, -128, -128, -128, -128, -128, -128, 9, 10, 11, 12, 13, -128, -128,
+   ' ', -128, -128, -128, -128, -128, -128, -128, -128, 9, 10, 11, 12, 13, -128, -128,
+   ' ', -128, -128, -128, -128, -128, -128, -128, -128, 9, 10, 11, 12, 13, -128, -128 };
+
+FILEAPP_TARGET("avx2")
+std::uint64_t Mask_AVX2(__m256i val) {
+   return static_cast<std::uint64_t>(static_cast<std::uint32_t>(_mm256_movemask_epi8(val)));
+   }
+
+/// the masks of 32 bytes at data, or'ed in at iShift
+FILEAPP_TARGET("avx2")
+inline void Part_Masks_AVX2(char const* data, __m256i blanks, std::uint64_t (&iMasks)[6], unsigned iShift) {
+   const __m256i block = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data));
+   const __m256i next  = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + 1));
+   const __m256i blank = _mm256_cmpeq_epi8(_mm256_shuffle_epi8(blanks, block), block);
+   const __m256i slash = _mm256_cmpeq_epi8(block, _mm256_set1_epi8('/'));
+   const __m256i after = _mm256_cmpeq_epi8(next, _mm256_set1_epi8('/'));
+   const __m256i open  = _mm256_or_si256(_mm256_or_si256(_mm256_and_si256(slash, _mm256_cmpeq_epi8(next, _mm256_set1_epi8('*'))),
+                                                         _mm256_and_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('R')),
+                                                                          _mm256_cmpeq_epi8(next, _mm256_set1_epi8('"')))),
+                                         _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\\')));
+   iMasks[0] |= Mask_AVX2(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('\n'))) << iShift;
+   iMasks[1] |= (Mask_AVX2(blank) ^ 0xffffffffu) << iShift;
+   iMasks[2] |= Mask_AVX2(_mm256_and_si256(slash, after)) << iShift;
+   iMasks[3] |= Mask_AVX2(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('#'))) << iShift;
+   iMasks[4] |= Mask_AVX2(open) << iShift;
+   iMasks[5] |= Mask_AVX2(_mm256_and_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('*')), after)) << iShift;
+   }
+
+/// processors with AVX2 have the popcnt instruction
+FILEAPP_TARGET("avx2,popcnt")
+size_t Line_Masks_AVX2(TLineChunk& chunk, size_t iOffset, TPlainLines* lines) {
+   const __m256i blanks = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(cBlankTable));
+   TPlainCount<Bit_Count_POPCNT> plain(lines, iOffset);
+   for(size_t b = 0u; b < chunk.iBlocks; ++b) {
+      char const* data = chunk.Block(b);
+      _mm_prefetch(data + iLinePrefetch, _MM_HINT_T0);
+      std::uint64_t iMasks[6] = { };
+      Part_Masks_AVX2(data, blanks, iMasks, 0u);
+      Part_Masks_AVX2(data + 32, blanks, iMasks, 32u);
+      Core_Masks(chunk.masks[b], iMasks);
+      plain.Block(chunk.masks[b], b);
+      }
+   return plain.Store(lines, chunk.iBlocks);
+   }
+
+FILEAPP_TARGET("avx2")
+void Line_Extra_AVX2(char const* data, size_t iBlocks, TLineMasks* masks) {
+   for(size_t b = 0u; b < iBlocks; ++b, data += 64) {
+      std::uint64_t iMasks[4] = { };
+      for(int i = 0; i < 2; ++i) {
+         const __m256i block = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + 32 * i));
+         const __m256i quote = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('"')),
+                                                               _mm256_cmpeq_epi8(block, _mm256_set1_epi8('\''))),
+                                               _mm256_cmpeq_epi8(block, _mm256_set1_epi8('/')));
+         iMasks[0] |= Mask_AVX2(quote) << (32 * i);
+         iMasks[1] |= Mask_AVX2(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('*'))) << (32 * i);
+         iMasks[2] |= Mask_AVX2(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('\\'))) << (32 * i);
+         iMasks[3] |= Mask_AVX2(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(')'))) << (32 * i);
+         }
+      Extra_Masks(masks[b], iMasks);
+      }
+   }
+
+FILEAPP_TARGET("avx512f,avx512bw,popcnt")
+size_t Line_Masks_AVX512(TLineChunk& chunk, size_t iOffset, TPlainLines* lines) {
+   const __m512i blanks = _mm512_loadu_si512(cBlankTable);
+   TPlainCount<Bit_Count_POPCNT> plain(lines, iOffset);
+   for(size_t b = 0u; b < chunk.iBlocks; ++b) {
+      char const* data = chunk.Block(b);
+      _mm_prefetch(data + iLinePrefetch, _MM_HINT_T0);
+      const __m512i block = _mm512_loadu_si512(data);
+      const __m512i next  = _mm512_loadu_si512(data + 1);
+      const __mmask64 slash = _mm512_cmpeq_epi8_mask(block, _mm512_set1_epi8('/'));
+      const __mmask64 after = _mm512_cmpeq_epi8_mask(next, _mm512_set1_epi8('/'));
+      TLineMasks& masks = chunk.masks[b];
+      masks.iNewline = _mm512_cmpeq_epi8_mask(block, _mm512_set1_epi8('\n'));
+      masks.iContent = _mm512_cmpneq_epi8_mask(_mm512_shuffle_epi8(blanks, block), block);
+      masks.iComment = slash & after;
+      masks.iHash    = _mm512_cmpeq_epi8_mask(block, _mm512_set1_epi8('#'));
+      masks.iOpen    = _mm512_mask_cmpeq_epi8_mask(slash, next, _mm512_set1_epi8('*')) |
+                       _mm512_mask_cmpeq_epi8_mask(_mm512_cmpeq_epi8_mask(block, _mm512_set1_epi8('R')), next, _mm512_set1_epi8('"')) |
+                       _mm512_cmpeq_epi8_mask(block, _mm512_set1_epi8('\\'));
+      masks.iClose   = _mm512_mask_cmpeq_epi8_mask(after, block, _mm512_set1_epi8('*'));
+      plain.Block(masks, b);
+      }
+   return plain.Store(lines, chunk.iBlocks);
+   }
+
+FILEAPP_TARGET("popcnt")
+size_t Plain_Blocks_POPCNT(TLineChunk const& chunk, size_t iOffset, TPlainLines& lines) {
+   return Plain_Blocks<Bit_Count_POPCNT>(chunk, iOffset, lines);
+   }
+#endif
+
+using Line_Masks_Func   = size_t (*)(TLineChunk&, size_t, TPlainLines*);
+using Line_Extra_Func   = void (*)(char const*, size_t, TLineMasks*);
+using Plain_Blocks_Func = size_t (*)(TLineChunk const&, size_t, TPlainLines&);
+
+struct TLineKernel {
+   Line_Masks_Func   masks;
+   Line_Extra_Func   extra;
+   Plain_Blocks_Func plain;
+   };
+
+/// masks with the same unit as the row kernel
+TLineKernel Line_Kernel() {
+   switch(eRowKernel) {
+#if defined(FILEAPP_HAS_X86_SIMD)
+      case ERowKernel::sse2:   return { Line_Masks_SSE2, Line_Extra_SSE2, Plain_Blocks_Scalar };
+      case ERowKernel::avx2:   return { Line_Masks_AVX2, Line_Extra_AVX2, Plain_Blocks_POPCNT };
+      case ERowKernel::avx512: return { Line_Masks_AVX512, Line_Extra_AVX2, Plain_Blocks_POPCNT };
+#endif
+      default:                 return { Line_Masks_Scalar, Line_Extra_Scalar, Plain_Blocks_Scalar };
+      }
+   }
+
+class TLineClassifier {
+   public:
+      explicit TLineClassifier(ELineSyntax syntax) : eSyntax(syntax), kernel(Line_Kernel()) { }
+
+      void       Feed(std::string_view block);
+      TLineStats Finish();
+
+   private:
+      enum class EState : int { code, line_comment, block_comment, string, character, raw_string };
+
+      char const*   Process(char const* begin, char const* p, char const* stop, char const* end);
+      void          Keep(char const* begin, char const* p, char const* end);
+      void          Text_Masks(TLineMasks const* masks, size_t iBlocks);
+      bool          Plain_State() const;
+      char const*   Plain_Lines(TLineChunk const& chunk, char const* p, size_t iEnd, TPlainLines& lines);
+      char const*   Mask_Line(TLineChunk& chunk, char const* p);
+      void          Lexer_Masks(TLineChunk& chunk, size_t iFrom, size_t iTo);
+      std::uint64_t Events(TLineMasks const& masks) const;
+      char const*   Event(char const* p, char const* end);
+      char const*   Code_Char(char const* p, char const* end);
+      char const*   Literal_Char(char const* p, char const* end);
+      char const*   Raw_String(char const* p, char const* end);
+      void          End_Line(char const* p, bool boNewline = true);
+
+      ELineSyntax     eSyntax;
+      TLineKernel     kernel;
+      EState          eState         = EState::code;
+      char const*     line           = nullptr;   // begin of the current line
+      bool            boCode         = false;     // kinds found in the current line
+      bool            boComment      = false;
+      bool            boPreprocessor = false;
+      std::string     delimiter;                  // of the raw string
+      std::string     rest;                       // incomplete line of the last block, bounded
+      size_t          iRestStart     = 0u;        // bytes of rest already walked, kept only to look behind
+      TLineStats      stats;
+   };
+
+void TLineClassifier::Feed(std::string_view block) {
+   char const* p   = block.data();
+   char const* end = p + block.size();
+   if(!rest.empty()) {
+      char const* eol = static_cast<char const*>(std::memchr(p, '\n', block.size()));
+      if(!eol) {
+         rest.append(p, end);
+         Keep(rest.data(), rest.data() + iRestStart, rest.data() + rest.size());
+         return;
+         }
+      rest.append(p, eol + 1);
+      Process(rest.data(), rest.data() + iRestStart, rest.data() + rest.size(), rest.data() + rest.size());
+      rest.clear();
+      iRestStart = 0u;
+      p = eol + 1;
+      }
+   char const* last = end;
+   while(last > p && last[-1] != '\n') --last;
+   if(last > p) Process(p, p, last, last);
+   Keep(last, last, end);
+   }
+
+TLineStats TLineClassifier::Finish() {
+   if(!rest.empty()) {
+      char const* end = rest.data() + rest.size();
+      Process(rest.data(), rest.data() + iRestStart, end, end);
+      End_Line(end, false);
+      rest.clear();
+      iRestStart = 0u;
+      }
+   return stats;
+   }
+
+/// the unfinished line [begin, end) from position p is kept in rest, a long one is walked before
+void TLineClassifier::Keep(char const* begin, char const* p, char const* end) {
+   if(static_cast<size_t>(end - p) > iLongLine) p = Process(begin, p, end - iLineAhead, end);
+   char const* keep = std::max(begin, p - std::min<std::ptrdiff_t>(p - begin, iLineBehind));
+   iRestStart = static_cast<size_t>(p - keep);
+   if(begin == rest.data()) rest.erase(0u, static_cast<size_t>(keep - begin));
+   else rest.assign(keep, end);
+   }
+
+/// count the line which ends at p, the state of a continued line is given to the next one
+void TLineClassifier::End_Line(char const* p, bool boNewline) {
+   char const* q = p;
+   if(q > line && q[-1] == '\r') --q;
+   const bool boContinued = q > line && q[-1] == '\\';
+
+   if(boPreprocessor)      ++stats.iPreprocessor;
+   else if(boCode)         ++stats.iCode;
+   else if(boComment)      ++stats.iComment;
+   else                    ++stats.iBlank;
+   if(boNewline) ++stats.iRows;
+
+   boPreprocessor = boPreprocessor && boContinued && eState == EState::code;
+   boCode         = eState == EState::string || eState == EState::character || eState == EState::raw_string;
+   boComment      = eState == EState::line_comment;
+   if(eState == EState::line_comment && !boContinued) {
+      eState    = EState::code;
+      boComment = false;
+      }
+   line = p + 1;
+   }
+
+/// a fresh line in code or in a block comment, which Plain_Lines() can take
+bool TLineClassifier::Plain_State() const {
+   return !boCode && !boPreprocessor && !boComment && (eState == EState::code || eState == EState::block_comment);
+   }
+
+/// bytes which can change the state, or the kind of the line while it's still blank
+std::uint64_t TLineClassifier::Events(TLineMasks const& masks) const {
+   const bool boOpen = !boCode && !boPreprocessor && !boComment;   // nothing but blanks on the line yet
+   switch(eState) {
+      case EState::code:          return masks.iNewline | (boCode || boPreprocessor ? masks.iQuote : masks.iContent);
+      case EState::line_comment:  return masks.iNewline;
+      case EState::block_comment: return masks.iNewline | (boOpen ? masks.iContent : masks.iStar);
+      case EState::string:
+      case EState::character:     return masks.iNewline | masks.iQuote | masks.iBackslash;
+      case EState::raw_string:    return masks.iNewline | masks.iParen;
+      }
+   return masks.iNewline;
+   }
+
+/// handle the marked byte at p, the position to go on
+char const* TLineClassifier::Event(char const* p, char const* end) {
+   switch(eState) {
+      case EState::code:
+         return Code_Char(p, end);
+      case EState::line_comment:
+         End_Line(p);
+         return p + 1;
+      case EState::block_comment:
+         if(*p == '\n') End_Line(p);
+         else if(!boCode && !boPreprocessor && !boComment) {
+            boComment = true;
+            return p;                        // the same byte again, now as '*' perhaps
+            }
+         else if(p + 1 < end && p[1] == '/') {
+            eState = EState::code;
+            return p + 2;
+            }
+         return p + 1;
+      case EState::string:
+      case EState::character:
+         return Literal_Char(p, end);
+      case EState::raw_string:
+         return Raw_String(p, end);
+      }
+   return p + 1;
+   }
+
+/// a byte in code which can change the state, the line is already classified when it isn't blank
+char const* TLineClassifier::Code_Char(char const* p, char const* end) {
+   switch(*p) {
+      case '\n':
+         End_Line(p);
+         return p + 1;
+      case '/':
+         if(p + 1 < end && (p[1] == '/' || p[1] == '*')) {
+            eState    = p[1] == '/' ? EState::line_comment : EState::block_comment;
+            boComment = true;
+            return p + 2;
+            }
+         boCode = true;
+         return p + 1;
+      case '"': {
+         boCode = true;
+         char const* q = p;
+         while(q > line && Is_Identifier(q[-1])) --q;
+         const std::string_view prefix(q, static_cast<size_t>(p - q));
+         if(prefix == "R" || prefix == "LR" || prefix == "uR" || prefix == "UR" || prefix == "u8R") {
+            char const* open = p + 1;
+            while(open < end && open - p <= 17 && *open != '(' && *open != ')' && *open != '\\' && !Is_Blank(*open) && *open != '\n') ++open;
+            if(open < end && *open == '(' && open - p <= 17) {
+               delimiter.assign(p + 1, open);
+               eState = EState::raw_string;
+               return open + 1;
+               }
+            }
+         eState = EState::string;
+         return p + 1;
+         }
+      case '\'':
+         boCode = true;
+         // digit separator as in 1'000'000 or 0xFF'FF, not u8'a'
+         if(p > line && Is_Hex_Digit(p[-1]) && p + 1 < end && Is_Hex_Digit(p[1]) && !(p + 2 < end && p[2] == '\'')) return p + 1;
+         eState = EState::character;
+         return p + 1;
+      case '#':
+         if(!boCode) boPreprocessor = true;
+         return p + 1;
+      default:
+         boCode = true;
+         return p + 1;
+      }
+   }
+
+/// escape, end of the literal or a line without end in a string or character literal
+char const* TLineClassifier::Literal_Char(char const* p, char const* end) {
+   switch(*p) {
+      case '\\': {
+         char const* q = p + 1;
+         if(q + 1 < end && *q == '\r' && q[1] == '\n') ++q;
+         if(q < end && *q == '\n') End_Line(q);       // continued literal
+         return std::min(q + 1, end);
+         }
+      case '\n':
+         eState = EState::code;
+         End_Line(p);
+         return p + 1;
+      case '"':
+      case '\'':
+         if((*p == '"') == (eState == EState::string)) eState = EState::code;
+         return p + 1;
+      default:
+         return p + 1;
+      }
+   }
+
+char const* TLineClassifier::Raw_String(char const* p, char const* end) {
+   if(*p == '\n') {
+      End_Line(p);
+      return p + 1;
+      }
+   const size_t iSize = delimiter.size();
+   if(static_cast<size_t>(end - p) > iSize + 1u && std::memcmp(p + 1, delimiter.data(), iSize) == 0 && p[iSize + 1u] == '"') {
+      eState = EState::code;
+      return p + iSize + 2u;
+      }
+   return p + 1;
+   }
+
+/// the lines of the fast path from p on up to iEnd to the statistic. Returns the begin of the
+/// first line which isn't counted, for the lexer when lines.boLexer is set, else unfinished
+char const* TLineClassifier::Plain_Lines(TLineChunk const& chunk, char const* p, size_t iEnd, TPlainLines& lines) {
+   TLineMasks const* masks   = chunk.masks;
+   const auto        iOffset = static_cast<size_t>(p - chunk.data);
+   // the unfinished line begins behind the last newline, its first content is taken back
+   size_t iLine = iOffset;
+   for(size_t b = (iEnd + 63u) / 64u; b-- > iOffset / 64u; ) {
+      std::uint64_t iNewline = masks[b].iNewline & (~std::uint64_t { 0u } << (b == iOffset / 64u ? iOffset % 64u : 0u));
+      if(iEnd < 64u * b + 64u) iNewline &= (std::uint64_t { 1u } << (iEnd % 64u)) - 1u;
+      if(iNewline != 0u) {
+         iLine = 64u * b + Highest_Bit(iNewline) + 1u;
+         break;
+         }
+      }
+   if(lines.iStart == 0u) {
+      for(size_t b = iLine / 64u; b < chunk.iBlocks; ++b) {
+         const std::uint64_t iContent = masks[b].iContent & (~std::uint64_t { 0u } << (b == iLine / 64u ? iLine % 64u : 0u));
+         if(iContent != 0u) {
+            const std::uint64_t bit = iContent & (0u - iContent);
+            if(lines.boBlock || (masks[b].iComment & bit) != 0u) --lines.iLines;
+            else if((masks[b].iHash & bit) != 0u) --lines.iDirectives;
+            --lines.iText;
+            break;
+            }
+         }
+      }
+   stats.iRows         += lines.iBlank + lines.iText;
+   stats.iBlank        += lines.iBlank;
+   stats.iComment      += lines.iLines;
+   stats.iPreprocessor += lines.iDirectives;
+   stats.iCode         += lines.iText - lines.iLines - lines.iDirectives;
+   line = chunk.data + iLine;
+   return line;
+   }
+
+/// the masks of the lexer for the blocks from the offset iFrom up to iTo
+void TLineClassifier::Lexer_Masks(TLineChunk& chunk, size_t iFrom, size_t iTo) {
+   for(size_t b = iFrom / 64u; b <= iTo / 64u && b < chunk.iBlocks; ++b) {
+      if((chunk.iExtra & (std::uint64_t { 1u } << b)) == 0u) {
+         kernel.extra(chunk.Block(b), 1u, chunk.masks + b);
+         chunk.iExtra |= std::uint64_t { 1u } << b;
+         }
+      }
+   }
+
+/**
+  \brief a line which the fast path doesn't take, classified from the masks too when it's simple
+  \details these are a block comment alone or its end alone, and a directive without quotes and
+           slashes (with a continuation too, or as a continued line). Returns the begin of the
+           next line, nullptr when the line is for the lexer
+*/
+char const* TLineClassifier::Mask_Line(TLineChunk& chunk, char const* p) {
+   TLineMasks const* masks    = chunk.masks;
+   const auto        iLine    = static_cast<size_t>(p - chunk.data);
+   const size_t      iNewline = Next_Mark(masks, &TLineMasks::iNewline, iLine, 64u * chunk.iBlocks);
+   if(iNewline == 64u * chunk.iBlocks || boCode || boComment) return nullptr;
+   EState eNext = eState;
+   size_t iFrom = iLine;
+   switch(eState) {
+      case EState::code:
+         if(!boPreprocessor) {
+            iFrom = Next_Mark(masks, &TLineMasks::iContent, iLine, iNewline);
+            if(iFrom == iNewline) return nullptr;
+            if(chunk.data[iFrom] == '#') break;
+            // "/*" as the first content, a "*/" behind it ends the comment
+            if(chunk.data[iFrom] != '/' || Next_Mark(masks, &TLineMasks::iOpen, iFrom, iFrom + 1u) != iFrom) return nullptr;
+            iFrom += 2u;
+            eNext = EState::block_comment;
+            }
+         break;
+      case EState::block_comment:
+         break;
+      default:
+         return nullptr;
+      }
+   if(eNext == EState::block_comment) {
+      if(const size_t iClose = Next_Mark(masks, &TLineMasks::iClose, iFrom, iNewline); iClose < iNewline) {
+         if(Next_Mark(masks, &TLineMasks::iContent, iClose + 2u, iNewline) < iNewline) return nullptr;
+         eNext = EState::code;
+         }
+      else if(eState == EState::block_comment) return nullptr;
+      boComment = true;
+      }
+   else {
+      Lexer_Masks(chunk, iFrom, iNewline);
+      if(Next_Mark(masks, &TLineMasks::iQuote, iFrom, iNewline) < iNewline) return nullptr;
+      boPreprocessor = true;
+      }
+   eState = eNext;
+   End_Line(chunk.data + iNewline);
+   return line;
+   }
+
+/**
+  \brief walk over the lines, the masks are built for chunks of iLineChunk blocks
+  \details the walk starts at p in a line which starts at begin (or isn't looked at before
+           begin), it ends at the first byte which changes the state at stop or behind, so
+           everything before stop is seen with all bytes up to end. The lines of the fast path
+           are counted from the masks, a line which goes over the end of the chunk starts the
+           next chunk. The lexer jumps in its lines from one marked byte to the next, the masks
+           it needs are built for a block when it comes there. Returns the position to go on
+*/
+char const* TLineClassifier::Process(char const* begin, char const* p, char const* stop, char const* end) {
+   line = begin;
+   TLineChunk chunk;
+   for(char const* data = p; data < end; ) {
+      // the masks look one byte behind a block, the last block is copied with blanks behind the end
+      const size_t iSize = std::min<size_t>(end - data, iLineChunk * 64u);
+      chunk.data    = data;
+      chunk.iBlocks = (iSize + 63u) / 64u;
+      chunk.iDirect = std::min<size_t>(chunk.iBlocks, (end - data - 1) / 64u);
+      chunk.iExtra  = 0u;
+      if(chunk.iDirect < chunk.iBlocks) {
+         char const* last = data + chunk.iDirect * 64u;
+         std::memset(chunk.padded, ' ', sizeof(chunk.padded));
+         std::memcpy(chunk.padded, last, static_cast<size_t>(end - last));
+         }
+      // a chunk which begins with a fresh line counts the fast path beside the masks
+      bool        boCounted = eSyntax != ELineSyntax::text && p == line && Plain_State();
+      TPlainLines lines { eState == EState::block_comment };
+      size_t      iEnd      = kernel.masks(chunk, static_cast<size_t>(p - data), boCounted ? &lines : nullptr);
+      char const* chunk_end = data + chunk.iBlocks * 64u;
+      char const* next      = chunk_end;
+      if(eSyntax == ELineSyntax::text) {
+         Text_Masks(chunk.masks, chunk.iBlocks);
+         data = next;
+         continue;
+         }
+      char const* lexed = nullptr;              // the line from here is for the lexer
+      while(p < chunk_end) {
+         if(p == line && p != lexed) {
+            if(boCounted || Plain_State()) {
+               if(!boCounted) {
+                  lines = TPlainLines { eState == EState::block_comment };
+                  iEnd  = kernel.plain(chunk, static_cast<size_t>(p - data), lines);
+                  }
+               boCounted = false;
+               p = Plain_Lines(chunk, p, iEnd, lines);
+               if(!lines.boLexer) {
+                  if(p > data) {
+                     next = p;
+                     break;
+                     }
+                  lexed = p;                    // a line longer than the chunk
+                  continue;
+                  }
+               }
+            if(char const* q = Mask_Line(chunk, p); q != nullptr) p = q;
+            else lexed = p;
+            continue;
+            }
+         const auto iOffset = static_cast<size_t>(p - data);
+         const auto iBlock  = iOffset / 64u;
+         Lexer_Masks(chunk, iOffset, iOffset);
+         if(const std::uint64_t events = Events(chunk.masks[iBlock]) & (~std::uint64_t { 0u } << (iOffset % 64u)); events != 0u) {
+            char const* at = data + iBlock * 64u + Lowest_Bit(events);
+            if(at >= stop) return at;
+            p = Event(at, end);
+            }
+         else p = data + iBlock * 64u + 64u;
+         }
+      data = next;
+      }
+   return eSyntax == ELineSyntax::text ? end : std::min(p, end);
+   }
+
+/// lines with content (as code) and blank lines, only the masks of newlines and content are used
+void TLineClassifier::Text_Masks(TLineMasks const* masks, size_t iBlocks) {
+   for(size_t b = 0u; b < iBlocks; ++b) {
+      std::uint64_t iContent = masks[b].iContent;
+      for(std::uint64_t iNewline = masks[b].iNewline; iNewline != 0u; iNewline &= iNewline - 1u) {
+         const std::uint64_t before = (std::uint64_t { 1u } << Lowest_Bit(iNewline)) - 1u;
+         if(boCode || (iContent & before) != 0u) ++stats.iCode;
+         else ++stats.iBlank;
+         ++stats.iRows;
+         boCode   = false;
+         iContent &= ~before;
+         }
+      boCode = boCode || iContent != 0u;
+      }
+   }
+
+} // end of anonymous namespace
+
+
+/// lines of the text by kind, in one pass
+TLineStats Classify_Lines(std::string_view text, ELineSyntax eSyntax) {
+   TLineClassifier classifier(eSyntax);
+   classifier.Feed(text);
+   return classifier.Finish();
+   }
+
+
+struct TLineStream::TImpl : public TLineClassifier {
+   using TLineClassifier::TLineClassifier;
+   };
+
+TLineStream::TLineStream(ELineSyntax eSyntax) : impl(std::make_unique<TImpl>(eSyntax)) { }
+
+TLineStream::~TLineStream() = default;
+
+void TLineStream::Feed(std::string_view block) {
+   impl->Feed(block);
+   }
+
+TLineStats TLineStream::Finish() {
+   return impl->Finish();
+   }
+
+
+//----------------------------------------------------------------------------
+// wc- style statistic of a text in one pass. For blocks of 64 bytes the masks
+// of '\n', '\r' and the bytes which aren't white space are built with the
+// kernels of the row counter unit. Words are the starts of content runs, the
+// line ends are taken from the masks and only they are visited one by one.
+// A '\r' at the end of a block waits for the next one to see if it's "\r\n".
+namespace {
+
+struct TStatsMasks {
+   std::uint64_t iNewline = 0u;
+   std::uint64_t iReturn  = 0u;
+   std::uint64_t iContent = 0u;   // no white space
+   };
+
+/// count of bits up to the highest set one, 0 for 0
+int Bit_Width(std::uint64_t val) {
+   if(val == 0u) return 0;
+#if defined(_MSC_VER) && !defined(__clang__)
+   unsigned long idx;
+   _BitScanReverse64(&idx, val);
+   return static_cast<int>(idx) + 1;
+#else
+   return 64 - __builtin_clzll(val);
+#endif
+   }
+
+void Stats_Masks_Scalar(char const* data, size_t iBlocks, TStatsMasks* masks) {
+   for(size_t b = 0u; b < iBlocks; ++b, data += 64) {
+      masks[b] = TStatsMasks { };
+      for(int i = 0; i < 64; ++i) {
+         const std::uint64_t bit = std::uint64_t { 1u } << i;
+         const char c = data[i];
+         if(c == '\n') masks[b].iNewline |= bit;
+         else if(c == '\r') masks[b].iReturn |= bit;
+         if(c != '\n' && !Is_Blank(c)) masks[b].iContent |= bit;
+         }
+      }
+   }
+
+#if defined(FILEAPP_HAS_X86_SIMD)
+FILEAPP_TARGET("sse2")
+void Stats_Masks_SSE2(char const* data, size_t iBlocks, TStatsMasks* masks) {
+   for(size_t b = 0u; b < iBlocks; ++b, data += 64) {
+      masks[b] = TStatsMasks { };
+      for(int i = 0; i < 4; ++i) {
+         const __m128i block = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + 16 * i));
+         const __m128i blank = _mm_or_si128(_mm_cmpeq_epi8(block, _mm_set1_epi8(' ')),
+                                            _mm_and_si128(_mm_cmpgt_epi8(block, _mm_set1_epi8(8)),
+                                                          _mm_cmplt_epi8(block, _mm_set1_epi8(14))));
+         masks[b].iNewline |= Mask_SSE2(_mm_cmpeq_epi8(block, _mm_set1_epi8('\n'))) << (16 * i);
+         masks[b].iReturn  |= Mask_SSE2(_mm_cmpeq_epi8(block, _mm_set1_epi8('\r'))) << (16 * i);
+         masks[b].iContent |= (Mask_SSE2(blank) ^ 0xffffu) << (16 * i);
+         }
+      }
+   }
+
+FILEAPP_TARGET("avx2")
+void Stats_Masks_AVX2(char const* data, size_t iBlocks, TStatsMasks* masks) {
+   for(size_t b = 0u; b < iBlocks; ++b, data += 64) {
+      masks[b] = TStatsMasks { };
+      for(int i = 0; i < 2; ++i) {
+         const __m256i block = _mm256_loadu_si256(reinterpret_cast<__m256i const*>(data + 32 * i));
+         const __m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(block, _mm256_set1_epi8(' ')),
+                                               _mm256_and_si256(_mm256_cmpgt_epi8(block, _mm256_set1_epi8(8)),
+                                                                _mm256_cmpgt_epi8(_mm256_set1_epi8(14), block)));
+         masks[b].iNewline |= Mask_AVX2(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('\n'))) << (32 * i);
+         masks[b].iReturn  |= Mask_AVX2(_mm256_cmpeq_epi8(block, _mm256_set1_epi8('\r'))) << (32 * i);
+         masks[b].iContent |= (Mask_AVX2(blank) ^ 0xffffffffu) << (32 * i);
+         }
+      }
+   }
+#endif
+
+using Stats_Masks_Func = void (*)(char const*, size_t, TStatsMasks*);
+
+Stats_Masks_Func Stats_Masks_Kernel() {
+   switch(eRowKernel) {
+#if defined(FILEAPP_HAS_X86_SIMD)
+      case ERowKernel::sse2:   return Stats_Masks_SSE2;
+      case ERowKernel::avx2:
+      case ERowKernel::avx512: return Stats_Masks_AVX2;
+#endif
+      default:                 return Stats_Masks_Scalar;
+      }
+   }
+
+class TTextCounter {
+   public:
+      TTextCounter() : stats_masks(Stats_Masks_Kernel()) { }
+
+      void       Feed(std::string_view block);
+      TTextStats Finish();
+
+   private:
+      void Process(TStatsMasks const& masks, int iSize);
+      void End_Line(std::uint64_t iEnd, std::uint64_t iLength);
+
+      Stats_Masks_Func stats_masks;
+      TTextStats       stats;
+      std::uint64_t    iPos       = 0u;      // position of the current block in the text
+      std::uint64_t    iLineStart = 0u;
+      bool             boWord     = false;   // last byte was content
+      bool             boReturn   = false;   // last byte was '\r'
+   };
+
+void TTextCounter::End_Line(std::uint64_t iEnd, std::uint64_t iLength) {
+   stats.iLongest = std::max(stats.iLongest, iLength);
+   ++stats.lengths[std::min<size_t>(Bit_Width(iLength), stats.lengths.size() - 1u)];
+   iLineStart = iEnd + 1u;
+   }
+
+/// masks of a block with iSize valid bytes, the bits above are 0
+void TTextCounter::Process(TStatsMasks const& masks, int iSize) {
+   const auto iLast = iSize - 1;
+   const std::uint64_t iCRLF = masks.iNewline & ((masks.iReturn << 1) | (boReturn ? 1u : 0u));
+   // '\r' at the end of the last block without '\n' at the start of this one
+   if(boReturn && !(masks.iNewline & 1u)) {
+      ++stats.iCR;
+      End_Line(iPos - 1u, iPos - 1u - iLineStart);
+      }
+   const std::uint64_t iCR = masks.iReturn & ~(masks.iNewline >> 1) & ~(std::uint64_t { 1u } << iLast);
+
+   stats.iWords += Bit_Count(masks.iContent & ~((masks.iContent << 1) | (boWord ? 1u : 0u)));
+   stats.iLines += Bit_Count(masks.iNewline);
+   stats.iCRLF  += Bit_Count(iCRLF);
+   stats.iLF    += Bit_Count(masks.iNewline & ~iCRLF);
+   stats.iCR    += Bit_Count(iCR);
+
+   for(auto ends = masks.iNewline | iCR; ends; ends &= ends - 1u) {
+      const auto iBit = Lowest_Bit(ends);
+      const std::uint64_t iEnd = iPos + iBit;
+      const std::uint64_t iCut = (iCRLF >> iBit) & 1u;   // '\r' of "\r\n" isn't part of the line
+      End_Line(iEnd, iEnd - iLineStart - iCut);
+      }
+   boWord   = (masks.iContent >> iLast) & 1u;
+   boReturn = (masks.iReturn >> iLast) & 1u;
+   iPos += static_cast<std::uint64_t>(iSize);
+   }
+
+void TTextCounter::Feed(std::string_view block) {
+   TStatsMasks masks[iLineChunk];
+   char const* p   = block.data();
+   char const* end = p + block.size();
+   while(end - p >= 64) {
+      const size_t iBlocks = std::min<size_t>(iLineChunk, static_cast<size_t>(end - p) / 64u);
+      stats_masks(p, iBlocks, masks);
+      for(size_t b = 0u; b < iBlocks; ++b) Process(masks[b], 64);
+      p += 64u * iBlocks;
+      }
+   if(p < end) {
+      alignas(64) char rest[64];
+      const auto iRest = static_cast<int>(end - p);
+      std::memcpy(rest, p, static_cast<size_t>(iRest));
+      std::memset(rest + iRest, ' ', static_cast<size_t>(64 - iRest));
+      Stats_Masks_Scalar(rest, 1u, masks);
+      Process(masks[0], iRest);
+      }
+   }
+
+TTextStats TTextCounter::Finish() {
+   if(boReturn) {
+      ++stats.iCR;
+      End_Line(iPos - 1u, iPos - 1u - iLineStart);
+      }
+   boReturn = false;
+   if(iLineStart < iPos) End_Line(iPos, iPos - iLineStart);
+   stats.iBytes = iPos;
+   return stats;
+   }
+
+} // end of anonymous namespace
+
+
+/// wc- style statistic of the text, in one pass
+TTextStats Text_Stats(std::string_view text) {
+   TTextCounter counter;
+   counter.Feed(text);
+   return counter.Finish();
+   }
+
+/// sum of the statistics, the longest line is the maximum
+TTextStats& operator += (TTextStats& sum, TTextStats const& val) {
+   sum.iBytes   += val.iBytes;
+   sum.iLines   += val.iLines;
+   sum.iWords   += val.iWords;
+   sum.iLongest  = std::max(sum.iLongest, val.iLongest);
+   sum.iLF      += val.iLF;
+   sum.iCRLF    += val.iCRLF;
+   sum.iCR      += val.iCR;
+   for(size_t i = 0u; i < sum.lengths.size(); ++i) sum.lengths[i] += val.lengths[i];
+   return sum;
+   }
+
+
+struct TTextStream::TImpl : public TTextCounter { };
+
+TTextStream::TTextStream() : impl(std::make_unique<TImpl>()) { }
+
+TTextStream::~TTextStream() = default;
+
+void TTextStream::Feed(std::string_view block) {
+   impl->Feed(block);
+   }
+
+TTextStats TTextStream::Finish() {
+   return impl->Finish();
+   }
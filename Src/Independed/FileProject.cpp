@@ -0,0 +1,196 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include "FileUtil.h"
+#include "FileUtilInternal.h"
+
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <unordered_map>
+#include <algorithm>
+#include <system_error>
+
+#if defined(__linux__)
+   #include <fcntl.h>
+   #include <unistd.h>
+   #include <sys/stat.h>
+   #include <sys/mman.h>
+#endif
+//---------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+// files of the projects for the parsers in Process.cpp: the paths of the files
+// are resolved with a cache of the resolved directories, and the content is
+// given as a private, writable copy to the parsers which work in place. Only
+// the part of a cbproj file up to the first ItemGroup is parsed, it's found
+// with a scan of the markup, without a parser.
+
+struct TPathResolver::TImpl {
+   std::mutex                                           guard;
+   std::unordered_map<fs::path::string_type, fs::path> dirs;   ///< absolute directory -> resolved
+
+   /// step of the resolution, name in the resolved directory parent
+   static fs::path Step(fs::path const& parent, fs::path const& name) {
+      if(name.empty() || name == ".") return parent;
+      if(name == "..") return parent.has_relative_path() ? parent.parent_path() : parent;
+      auto path = parent / name;
+      std::error_code ec;
+      if(fs::symlink_status(path, ec).type() == fs::file_type::symlink) return fs::weakly_canonical(path);
+      return path;
+      }
+
+   fs::path Directory(fs::path const& dir) {
+      {
+      std::lock_guard<std::mutex> lock(guard);
+      if(auto it = dirs.find(dir.native()); it != dirs.end()) return it->second;
+      }
+      const auto parent = dir.parent_path();
+      auto ret = parent == dir || !dir.has_relative_path() ? dir : Step(Directory(parent), dir.filename());
+      std::lock_guard<std::mutex> lock(guard);
+      return dirs.emplace(dir.native(), std::move(ret)).first->second;
+      }
+   };
+
+TPathResolver::TPathResolver() : impl(std::make_unique<TImpl>()) { }
+
+TPathResolver::~TPathResolver() = default;
+
+fs::path TPathResolver::Resolve(fs::path const& file) {
+   const auto path = fs::absolute(file);   // not lexically normal, ".." behind a link is resolved like weakly_canonical()
+   if(!path.has_relative_path()) return path;
+   return TImpl::Step(impl->Directory(path.parent_path()), path.filename());
+   }
+
+#if defined(__linux__)
+class TFileCopy::TGuard : public TMapGuard {
+   public:
+      using TMapGuard::TMapGuard;
+   };
+#else
+class TFileCopy::TGuard { };
+#endif
+
+TFileCopy::TFileCopy(fs::path const& file) : path(file) {
+#if defined(__linux__)
+   const int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+   if(fd < 0) Raise_File_Error("cannot open file", file, errno);
+   struct ::stat status;
+   if(::fstat(fd, &status) != 0) {
+      const int err = errno;
+      ::close(fd);
+      Raise_File_Error("cannot get file status", file, err);
+      }
+   iSize = static_cast<size_t>(status.st_size);
+   if(S_ISREG(status.st_mode) && iSize > 0u) {
+      if(void* mapped = ::mmap(nullptr, iSize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0); mapped != MAP_FAILED) {
+         ::madvise(mapped, iSize, MADV_SEQUENTIAL);
+         view     = static_cast<char*>(mapped);
+         boMapped = true;
+         guard    = std::make_unique<TGuard>(mapped, iSize, PROT_READ | PROT_WRITE);
+         }
+      }
+   ::close(fd);
+   if(boMapped || iSize == 0u) return;
+#endif
+   std::ifstream ifs(file, std::ios::binary);
+   if(!ifs.is_open()) Raise_File_Error("cannot open file", file, ENOENT);
+   buffer.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+   if(ifs.bad()) Raise_File_Error("cannot read file", file, EIO);
+   view  = buffer.data();
+   iSize = buffer.size();
+   }
+
+TFileCopy::~TFileCopy() {
+#if defined(__linux__)
+   guard.reset();
+   if(boMapped) ::munmap(view, iSize);
+#endif
+   }
+
+/// throws a filesystem_error when the file was truncated while it was mapped
+void TFileCopy::Check() const {
+#if defined(__linux__)
+   if(guard) guard->Check(path);
+#endif
+   }
+
+namespace {
+
+/// position behind the end of the markup at iPos which has no elements (comment, CDATA, declaration, instruction), npos when it isn't closed
+size_t Skip_Markup(std::string_view text, size_t iPos) {
+   auto skip_to = [text](std::string_view strEnd, size_t iFrom) {
+      const auto iEnd = text.find(strEnd, iFrom);
+      return iEnd == std::string_view::npos ? iEnd : iEnd + strEnd.size();
+      };
+   const auto rest = text.substr(iPos);
+   if(rest.compare(0u, 4u, "<!--") == 0)      return skip_to("-->", iPos + 4u);
+   if(rest.compare(0u, 9u, "<![CDATA[") == 0) return skip_to("]]>", iPos + 9u);
+   if(rest.compare(0u, 2u, "<?") == 0)        return skip_to("?>", iPos + 2u);
+   // <!DOCTYPE ...>, an internal subset in [] can contain '>'
+   const auto iEnd = text.find_first_of("[>", iPos + 2u);
+   if(iEnd == std::string_view::npos || text[iEnd] == '>') return skip_to(">", iPos + 2u);
+   return skip_to("]>", iEnd);
+   }
+
+} // end of anonymous namespace
+
+/**
+   \brief end of the part of a cbproj file which ParseProject() needs
+   \details the content behind the first "</ItemGroup>", mostly the bigger part with the
+            settings of the IDE, isn't parsed. The root element is closed in the buffer
+            directly behind it, so the text is changed. The tags are scanned with their
+            depth, comments, CDATA sections, declarations and instructions are skipped,
+            '>' in the values of attributes doesn't end a tag. When the first ItemGroup
+            isn't a child of the root the elements around it are needed, the text isn't
+            cut then.
+   \returns size of the part, the whole size if the text can't be cut
+*/
+size_t Cut_After_ItemGroup(char* data, size_t iSize) {
+   const std::string_view text(data, iSize);
+   const std::string_view strGroup = "ItemGroup";
+   std::string_view root;
+   size_t iDepth = 0u;
+   for(size_t iPos = text.find('<'); iPos != std::string_view::npos; iPos = text.find('<', iPos)) {
+      if(iPos + 1u >= iSize) return iSize;
+      if(text[iPos + 1u] == '!' || text[iPos + 1u] == '?') {
+         if((iPos = Skip_Markup(text, iPos)) == std::string_view::npos) return iSize;
+         continue;
+         }
+      const bool   boClose = text[iPos + 1u] == '/';
+      const size_t iName   = iPos + (boClose ? 2u : 1u);
+      const auto   iAfter  = text.find_first_of(" \t\r\n/>", iName);
+      if(iAfter == std::string_view::npos) return iSize;
+      const auto name = text.substr(iName, iAfter - iName);
+      size_t iEnd = iAfter;
+      for(char cQuote = '\0'; iEnd < iSize && (cQuote != '\0' || text[iEnd] != '>'); ++iEnd) {
+         if(cQuote != '\0') { if(text[iEnd] == cQuote) cQuote = '\0'; }
+         else if(text[iEnd] == '"' || text[iEnd] == '\'') cQuote = text[iEnd];
+         }
+      if(iEnd >= iSize) return iSize;
+      iPos = iEnd + 1u;
+      const bool boEmpty = !boClose && text[iEnd - 1u] == '/';
+      if(!boClose) {
+         if(iDepth == 0u) {
+            if(!root.empty()) return iSize;   // a second root, not a document
+            root = name;
+            }
+         if(!boEmpty) {
+            ++iDepth;
+            continue;
+            }
+         }
+      else if(iDepth-- == 0u) return iSize;
+      if(name != strGroup) continue;
+      if(iDepth != 1u) return iSize;   // the first ItemGroup isn't a child of the root
+      const std::string strClose = "</" + std::string(root) + ">";
+      const size_t iPart = iPos + strClose.size();
+      if(iPart >= iSize) return iSize;
+      std::copy(strClose.begin(), strClose.end(), data + iPos);
+      return iPart;
+      }
+   return iSize;
+   }
+
@@ -0,0 +1,276 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include "FileUtil.h"
+#include "FileUtilInternal.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <unordered_map>
+#include <system_error>
+#include <cstdint>
+#include <cerrno>
+
+#if defined(__linux__)
+   #include <unistd.h>
+   #include <sys/stat.h>
+#endif
+//---------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+// snapshot of a directory tree, for every directory the signature of the
+// directory and the values of the direct entries. When the signature of a
+// directory is unchanged, its list of entries is unchanged too and it isn't
+// read again, only the subdirectories are checked.
+// Limit: a file which is changed in place (new size, same name) doesn't touch
+// the signature of its directory, a full rescan is necessary in this case.
+namespace {
+
+const char   strSnapshotMagic[8] = { 'F', 'A', 'S', 'N', 'A', 'P', '0', '2' };
+const size_t iNoNode = static_cast<size_t>(-1);
+
+struct TDirSignature {
+   std::uint64_t iDevice   = 0u;
+   std::uint64_t iInode    = 0u;
+   std::int64_t  iModified = 0;
+   std::int64_t  iChanged  = 0;
+
+   bool operator == (TDirSignature const& other) const {
+      return iDevice == other.iDevice && iInode == other.iInode &&
+             iModified == other.iModified && iChanged == other.iChanged;
+      }
+   };
+
+struct TSnapshotNode {
+   std::string         strName;      // name relative to the parent, complete path for the root
+   std::uint64_t       iParent = iNoNode;
+   TDirSignature       signature;
+   Dir_Stats_Type      own { 0ul, 0ul, 0ull };  // direct files, all subdirectories, size of direct files
+   std::vector<size_t> children;                 // not hidden subdirectories, not saved
+   };
+
+using Snapshot_Type = std::vector<TSnapshotNode>;
+
+
+TDirSignature Dir_Signature(fs::path const& dir) {
+   TDirSignature ret;
+#if defined(__linux__)
+   struct ::stat status;
+   if(::stat(dir.c_str(), &status) != 0) {
+      int err = errno;
+      if(err == ENAMETOOLONG) {
+         if(int fd = Open_Directory(dir); fd >= 0) {
+            err = ::fstat(fd, &status) == 0 ? 0 : errno;
+            ::close(fd);
+            }
+         else err = errno;
+         }
+      if(err != 0) throw fs::filesystem_error("cannot get status", dir, std::error_code(err, std::generic_category()));
+      }
+   ret.iDevice   = status.st_dev;
+   ret.iInode    = status.st_ino;
+   ret.iModified = static_cast<std::int64_t>(status.st_mtim.tv_sec) * 1'000'000'000 + status.st_mtim.tv_nsec;
+   ret.iChanged  = static_cast<std::int64_t>(status.st_ctim.tv_sec) * 1'000'000'000 + status.st_ctim.tv_nsec;
+#else
+   ret.iModified = fs::last_write_time(dir).time_since_epoch().count();
+#endif
+   return ret;
+   }
+
+template <typename ty>
+void Write_Value(std::ostream& out, ty const& val) {
+   out.write(reinterpret_cast<char const*>(&val), sizeof(ty));
+   }
+
+template <typename ty>
+bool Read_Value(std::istream& in, ty& val) {
+   return static_cast<bool>(in.read(reinterpret_cast<char*>(&val), sizeof(ty)));
+   }
+
+void Write_String(std::ostream& out, std::string const& val) {
+   Write_Value(out, static_cast<std::uint32_t>(val.size()));
+   out.write(val.data(), val.size());
+   }
+
+/// a length above iLimit (the size of the file) is damage, nothing is allocated for it
+bool Read_String(std::istream& in, std::string& val, std::uint64_t iLimit) {
+   std::uint32_t iSize;
+   if(!Read_Value(in, iSize) || iSize > iLimit) return false;
+   val.resize(iSize);
+   return static_cast<bool>(in.read(val.data(), iSize));
+   }
+
+
+/// read a snapshot, empty when the file is missing, damaged or for another root or other patterns
+Snapshot_Type Load_Snapshot(fs::path const& file, fs::path const& root, std::string const& strPatterns) {
+   Snapshot_Type ret;
+   std::ifstream ifs(file, std::ios::binary);
+   if(!ifs.is_open()) return ret;
+   std::error_code ec;
+   const std::uint64_t iFileSize = fs::file_size(file, ec);
+   if(ec) return ret;
+   // smallest node: length of an empty name, parent, signature and the three values
+   const std::uint64_t iMinNode = sizeof(std::uint32_t) + sizeof(std::uint64_t) + sizeof(TDirSignature) + 3u * sizeof(std::uint64_t);
+
+   char magic[sizeof(strSnapshotMagic)];
+   std::string strRoot, strFilePatterns;
+   std::uint64_t iCount;
+   if(!ifs.read(magic, sizeof(magic)) || !std::equal(magic, magic + sizeof(magic), strSnapshotMagic) ||
+      !Read_String(ifs, strRoot, iFileSize) || strRoot != root.string() ||
+      !Read_String(ifs, strFilePatterns, iFileSize) || strFilePatterns != strPatterns || !Read_Value(ifs, iCount)) return ret;
+   const auto iPos = ifs.tellg();
+   if(iPos < 0 || iCount > (iFileSize - static_cast<std::uint64_t>(iPos)) / iMinNode) return ret;
+
+   ret.resize(iCount);
+   for(size_t i = 0u; i < ret.size(); ++i) {
+      auto& node = ret[i];
+      std::uint64_t files, dirs, size;
+      if(!Read_String(ifs, node.strName, iFileSize) || !Read_Value(ifs, node.iParent) || !Read_Value(ifs, node.signature) ||
+         !Read_Value(ifs, files) || !Read_Value(ifs, dirs) || !Read_Value(ifs, size) ||
+         (i == 0u) != (node.iParent == iNoNode) || (i > 0u && node.iParent >= i)) return { };
+      node.own = Dir_Stats_Type { files, dirs, size };
+      if(i > 0u) ret[node.iParent].children.emplace_back(i);
+      }
+   return ret;
+   }
+
+/// write to a temporary file and rename it, a reader never sees a half written snapshot
+void Save_Snapshot(fs::path const& file, fs::path const& root, std::string const& strPatterns, Snapshot_Type const& snapshot) {
+   const fs::path temp = Create_Temp_File(file);
+   {
+   std::ofstream ofs(temp, std::ios::binary | std::ios::trunc);
+   if(!ofs.is_open()) throw std::runtime_error("error while opening snapshot file \"" + temp.string() + "\".");
+   ofs.write(strSnapshotMagic, sizeof(strSnapshotMagic));
+   Write_String(ofs, root.string());
+   Write_String(ofs, strPatterns);
+   Write_Value(ofs, static_cast<std::uint64_t>(snapshot.size()));
+   for(auto const& node : snapshot) {
+      Write_String(ofs, node.strName);
+      Write_Value(ofs, node.iParent);
+      Write_Value(ofs, node.signature);
+      Write_Value(ofs, static_cast<std::uint64_t>(std::get<0>(node.own)));
+      Write_Value(ofs, static_cast<std::uint64_t>(std::get<1>(node.own)));
+      Write_Value(ofs, static_cast<std::uint64_t>(std::get<2>(node.own)));
+      }
+   if(!ofs) {
+      ofs.close();
+      std::error_code ec;
+      fs::remove(temp, ec);
+      throw std::runtime_error("error while writing snapshot file \"" + temp.string() + "\".");
+      }
+   }
+   std::error_code ec;
+   fs::rename(temp, file, ec);
+   if(ec) {
+      fs::remove(temp, ec);
+      throw std::runtime_error("error while replacing snapshot file \"" + file.string() + "\".");
+      }
+   }
+
+
+/**
+  \brief the walk of Count_Snapshot(), the nodes of the directories in snapshot in the order of the walk
+  \details the pending directories are kept in memory without the budget of Set_Traversal_Memory(),
+           there are never more of them than nodes in snapshot, which holds every directory of the
+           tree anyway. So the memory of this path is unbounded, it grows with the count of directories
+*/
+Dir_Stats_Type Count_Snapshot_Tree(fs::path const& root, Snapshot_Type const& old_snapshot, Snapshot_Type& snapshot,
+                                   bool boFullRescan, TScanFilter const& filter) {
+   struct TWork {
+      fs::path    dir;
+      std::string strName;
+      size_t      iOld;
+      size_t      iParent;
+      };
+
+   Dir_Stats_Type ret { 0ul, 0ul, 0ull };
+   std::vector<TWork> stack;
+   stack.push_back({ root, root.string(), old_snapshot.empty() ? iNoNode : 0u, iNoNode });
+   std::vector<std::pair<std::string, size_t>> subdirs;   // name and node in the old snapshot
+   while(!stack.empty()) {
+      TWork work = std::move(stack.back());
+      stack.pop_back();
+      auto const& dir  = work.dir;
+      const size_t iOld = work.iOld;
+
+      TSnapshotNode node;
+      node.strName   = std::move(work.strName);
+      node.iParent   = work.iParent;
+      Scan_Control().Check();
+      node.signature = Dir_Signature(dir);
+      subdirs.clear();
+
+      if(!boFullRescan && iOld != iNoNode && old_snapshot[iOld].signature == node.signature) {
+         node.own = old_snapshot[iOld].own;
+         Scan_Control().Add_Dir();
+         for(auto idx : old_snapshot[iOld].children) subdirs.emplace_back(old_snapshot[idx].strName, idx);
+         }
+      else {
+         std::unordered_map<std::string_view, size_t> old_children;
+         if(iOld != iNoNode) {
+            for(auto idx : old_snapshot[iOld].children) old_children.emplace(old_snapshot[idx].strName, idx);
+            }
+         auto find_old = [&old_children](std::string const& name) {
+                  auto it = old_children.find(name);
+                  return it != old_children.end() ? it->second : iNoNode;
+                  };
+
+         const auto rel_dir = filter.Relative(dir);
+         Read_Entries(dir, [&](auto const& entry) {
+                  const bool boDirectory = entry.is_directory();
+                  if(filter.Excluded(rel_dir, entry.filename(), boDirectory)) return;
+                  if(boDirectory) {
+                     ++node.own;
+                     if(!filter.Hidden(entry.filename())) {
+                        std::string name(entry.filename());
+                        auto idx = find_old(name);
+                        subdirs.emplace_back(std::move(name), idx);
+                        }
+                     }
+                  else node.own += entry.file_size();
+                  });
+         }
+
+      ret += node.own;
+      Scan_Control().Add_Files(std::get<0>(node.own), std::get<2>(node.own));
+      const size_t iCurrent = snapshot.size();
+      snapshot.emplace_back(std::move(node));
+      for(auto it = subdirs.rbegin(); it != subdirs.rend(); ++it)
+         stack.push_back({ dir / it->first, std::move(it->first), it->second, iCurrent });
+      }
+   return ret;
+   }
+
+} // end of anonymous namespace
+
+
+/// default place for the snapshot of a directory, in the cache directory of the user
+fs::path Snapshot_File(fs::path const& dir) {
+   std::ostringstream os;
+   os << "FileApp_" << std::hex << std::hash<std::string>{}(fs::absolute(dir).string()) << ".snapshot";
+   return Cache_Directory() / os.str();
+   }
+
+
+/** count the directory recursive like Count(dir, true) and reuse the values of all
+    directories with unchanged signature from the snapshot, the snapshot is updated
+    afterwards. With boFullRescan all directories are read again. The old and the new
+    snapshot are in memory with all directories, the walk isn't bounded by Set_Traversal_Memory(). */
+Dir_Stats_Type Count_Snapshot(fs::path const& dir, fs::path const& snapshot_file, bool boFullRescan) {
+   if(Is_Hidden(dir)) return Dir_Stats_Type { 0ul, 0ul, 0ull };
+   TScanFilter filter(dir);
+   auto old_snapshot = boFullRescan ? Snapshot_Type { } : Load_Snapshot(snapshot_file, dir, filter.Signature());
+   Snapshot_Type snapshot;
+   snapshot.reserve(old_snapshot.size());
+   auto ret = Count_Snapshot_Tree(dir, old_snapshot, snapshot, boFullRescan, filter);
+   try {
+      Save_Snapshot(snapshot_file, dir, filter.Signature(), snapshot);
+      }
+   catch(std::exception& ex) {
+      std::cerr << "error in " << __func__ << ": " << ex.what() << std::endl;
+      }
+   return ret;
+   }
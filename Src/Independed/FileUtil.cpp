@@ -3,15 +3,21 @@
 #pragma hdrstop
 
 #include "FileUtil.h"
+#include "FileUtilInternal.h"
 
 #include <iostream>
-#include <fstream>
 #include <iomanip>
 #include <sstream>
-#include <functional>
-#include <cctype> //std::tolower ohne locale
-#include <locale>
 #include <chrono>
+#include <thread>
+#include <atomic>
+#include <system_error>
+#include <cstdlib>
+
+#if defined(__linux__)
+   #include <fcntl.h>
+   #include <unistd.h>
+#endif
 //---------------------------------------------------------------------------
 
 
@@ -24,6 +30,20 @@ std::uintmax_t Convert_Size_KiloByte(std::uintmax_t val) {
    }
 
 
+/// control of the running scan, one for the whole program, the ui runs only one action at a time
+TScanControl& Scan_Control() {
+   static TScanControl control;
+   return control;
+   }
+
+void TScanControl::Reset() {
+   boCancel.store(false, std::memory_order_relaxed);
+   iDirs.store(0u, std::memory_order_relaxed);
+   iFiles.store(0u, std::memory_order_relaxed);
+   iBytes.store(0u, std::memory_order_relaxed);
+   }
+
+
 std::ostream& operator << (std::ostream& out, Dir_Stats_Type const& val) {
    return out
        << std::left << std::setw(15) << "files:"       << std::right << std::setw(20) << std::get<0>(val) << std::endl
@@ -60,84 +80,54 @@ Dir_Stats_Type operator ++ (Dir_Stats_Type& sum, int) {
 
 
 //----------------------------------------------------------------------------
-bool Is_Hidden(fs::path const& dir) {
-    std::set<fs::path> hidden = { "__history", "__astcache", "__recovery",
-                                  ".git", ".svn", ".vs", "win32", "win64"  };
-    static auto to_lower_string = [](fs::path const& p) {
-                                std::string ret = p.filename().string();
-                                std::transform(ret.begin(), ret.end(), ret.begin(), [](auto c) {
-                                        return std::tolower(c);
-                                        });
-                                return ret;
-                                };
-    if(!fs::is_directory(dir)) return false;
-    return hidden.find(to_lower_string(dir)) != hidden.end();
-   }
-
-
+// files of the program: errors of the readers, temporary files for the writes
+// which end with a rename and the directory for the caches of the user
 
-Dir_Stats_Type Count(fs::path const& dir, bool boWithSub) {
-   auto ret = Dir_Stats_Type { 0ul, 0ul, 0ull  };
-   std::vector<fs::path> content;
-   if(Is_Hidden(dir)) return ret;
-   std::copy(fs::directory_iterator(dir), fs::directory_iterator(), std::back_inserter(content));
-   auto it = std::partition(content.begin(), content.end(), [](auto const& val) { return fs::is_directory(val); });
-   if(boWithSub) std::for_each(content.begin(), it, [&ret](auto const& val) { ++ret += Count(val, true); });
-   else std::get<1>(ret) += std::distance(content.begin(), it);
-   std::for_each(it, content.end(), [&ret](auto const& val) { ret += fs::file_size(val); });
-   return ret;
+[[noreturn]] void Raise_File_Error(char const* what, fs::path const& file, int err) {
+   throw fs::filesystem_error(what, file, std::error_code(err, std::generic_category()));
    }
 
-
-
-size_t Find(std::vector<fs::path>& ret, fs::path const& dir, std::set<std::string> const& extensions, bool boWithSub) {
-   static auto constexpr check_func = [](fs::path const& p) { return !fs::is_directory(p); };
-   auto check_func2          = [&extensions](fs::path const& p) {
-                                             return extensions.find(p.extension().string()) != extensions.end();
-                                             };
-   auto collect_func = [&ret](fs::path const& p) mutable { ret.emplace_back(p.string()); };
-   auto call_func = std::bind(Find, std::ref(ret), std::placeholders::_1, std::cref(extensions), boWithSub);
-
-   if(Is_Hidden(dir)) return 0u;
-   try {
-      std::vector<fs::path> files;
-      std::copy(fs::directory_iterator(dir), fs::directory_iterator(), std::back_inserter(files));
-      auto it  = std::partition(files.begin(), files.end(), check_func);
-      auto it2 = std::partition(files.begin(), it, check_func2);
-      std::copy(files.begin(), it2, std::back_inserter(ret));
-      if(boWithSub && it != files.end()) {
-         std::for_each(it, files.end(), call_func);
+/**
+  \brief new, empty temporary file beside file, for a write which ends with a rename
+  \details the name is unique for concurrent writers, on linux the file is created
+           exclusively and only for the user, so no prepared file or link is used
+*/
+fs::path Create_Temp_File(fs::path const& file) {
+   static std::atomic<unsigned> iSerial { 0u };
+   for(int iTry = 0; ; ++iTry) {
+      std::ostringstream os;
+      os << ".tmp" << std::hex << std::hash<std::thread::id>{}(std::this_thread::get_id()) << '_'
+         << std::chrono::steady_clock::now().time_since_epoch().count() << '_' << iSerial++;
+      fs::path temp = file;
+      temp += os.str();
+#if defined(__linux__)
+      const int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, 0600);
+      if(fd >= 0) {
+         ::close(fd);
+         return temp;
          }
+      if(errno != EEXIST || iTry >= 16)
+         throw fs::filesystem_error("cannot create temporary file", temp, std::error_code(errno, std::generic_category()));
+#else
+      static_cast<void>(iTry);
+      return temp;
+#endif
       }
-   catch(std::exception& ex) {
-      std::cerr << "error: " << ex.what() << std::endl;
-      }
-   return ret.size();
    }
 
-
-size_t CheckFileSize(fs::path const& strFile) {
-   size_t ret = 0u;
-   try {
-      std::ifstream ifs(strFile.string());
-      if( !ifs.is_open()) {
-         std::ostringstream os;
-         os << "error while opening file \"" << strFile.string() << "\".";
-         throw std::runtime_error(os.str().c_str());
-         }
-      const auto iSize = fs::file_size(strFile);
-      std::string strBuff(iSize, '\0');
-      ifs.read(strBuff.data(), iSize);
-      ifs.close();
-      std::string_view test(strBuff.data(), strBuff.size());
-      ret = std::count(test.begin(), test.end(), '\n');
-      }
-   catch(std::exception & ex) {
-      std::cerr << "error in " << __func__ << ": " << ex.what() << std::endl;
+/// directory for the caches of the user, the temporary directory when there is none
+fs::path Cache_Directory() {
+   fs::path base;
+#if defined(__linux__)
+   if(char const* xdg = std::getenv("XDG_CACHE_HOME"); xdg && *xdg) base = xdg;
+   else if(char const* home = std::getenv("HOME"); home && *home) base = fs::path(home) / ".cache";
+#else
+   if(char const* local = std::getenv("LOCALAPPDATA"); local && *local) base = local;
+#endif
+   if(!base.empty()) {
+      std::error_code ec;
+      fs::create_directories(base / "FileApp", ec);
+      if(!ec) return base / "FileApp";
       }
-   return ret;
+   return fs::temp_directory_path();
    }
-
-
-
-
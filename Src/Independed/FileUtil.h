@@ -7,9 +7,22 @@
 #include <vector>
 #include <set>
 #include <string>
+#include <string_view>
+#include <functional>
+#include <memory>
+#include <chrono>
+#include <ctime>
+#include <cstdint>
+#include <utility>
+#include <atomic>
+#include <stdexcept>
+#include <array>
 
 namespace fs = std::filesystem;
 
+/// receiver for batches of files found by Find_Stream(), called in the calling thread
+using Find_Sink_Type = std::function<void (std::vector<fs::path>&&)>;
+
 using Dir_Stats_Type = std::tuple<unsigned long, unsigned long, unsigned long long>;
 
 std::ostream& operator << (std::ostream& out, Dir_Stats_Type const& val);
@@ -18,11 +31,307 @@ Dir_Stats_Type& operator += (Dir_Stats_Type& sum, std::uintmax_t const& size);
 Dir_Stats_Type& operator ++ (Dir_Stats_Type& sum);
 Dir_Stats_Type operator ++ (Dir_Stats_Type& sum, int);
 
+/// engine to read the entries of directories in Count() and Find()
+enum class ETraversalBackend : int {
+   filesystem,   ///< portable, std::filesystem::directory_iterator
+   native        ///< linux only, getdents64 / fstatat relative to the open directory
+   };
+
+/// vector unit for counting rows, selected at runtime with cpuid
+enum class ERowKernel : int {
+   scalar,       ///< portable, std::count
+   sse2,         ///< x86, 16 bytes per step
+   avx2,         ///< x86, 32 bytes per step
+   avx512        ///< x86 with AVX-512BW, 64 bytes per step
+   };
+
+/// rules for the kinds of lines in Classify_Lines() and Count_Lines()
+enum class ELineSyntax : int {
+   cpp,          ///< C/C++ sources, code, comment, blank and preprocessor lines
+   text          ///< forms and other text, only lines with content (as code) and blank lines
+   };
+
+/// kind of the content of a file, found with a sniff of the first block
+enum class EContentKind : int {
+   text,         ///< ASCII, UTF-8 or a code page with 8 bit
+   utf16le,      ///< UTF-16 little endian, with BOM or from the positions of the NUL bytes
+   utf16be,      ///< UTF-16 big endian
+   binary,       ///< NUL bytes or too many control bytes
+   form_binary   ///< binary stream of a form (dfm / fmx), signature "TPF0"
+   };
+
+/// handling of files which aren't plain text in the row counters, Set_Binary_Policy()
+enum class EBinaryPolicy : int {
+   count,        ///< all files are counted byte by byte, like without the sniff
+   skip,         ///< binary files aren't read after the sniff and have 0 rows, UTF-16 files too
+   decode        ///< like skip, but UTF-16 files are decoded and their characters counted
+   };
+
+/// use of the page cache by the content readers, Set_Read_Mode()
+enum class EReadMode : int {
+   cached,       ///< small files read, larger ones mapped, the pages stay in the cache
+   dontneed,     ///< read in blocks, pages brought into the cache by the read are dropped after each block
+   direct        ///< linux O_DIRECT with an aligned buffer, the cache isn't used; dontneed where not supported
+   };
+
+/**
+  \brief lines of a file by kind, every line has exactly one kind
+  \details a line with code and a comment is code, a line of a directive is a
+           preprocessor line. iRows is the count of '\n' like Count_Rows(), the
+           kinds count a last line without '\n' too.
+*/
+struct TLineStats {
+   std::uint64_t iRows         = 0u;
+   std::uint64_t iCode         = 0u;
+   std::uint64_t iComment      = 0u;
+   std::uint64_t iBlank        = 0u;
+   std::uint64_t iPreprocessor = 0u;
+   EContentKind  eKind         = EContentKind::text;   ///< sniffed kind of the file
+   std::uint64_t iBytes        = 0u;                   ///< size of the counted content, 0 for skipped files
+   bool          boCompressed  = false;                ///< gzip / zstd, with Set_Decompression() counts and iBytes are of the decompressed content
+   };
+
+/**
+  \brief wc- style statistic of a text, result of Text_Stats() and Count_Text()
+  \details iLines is the count of '\n' like wc -l. For the lengths a line ends with
+           '\n', "\r\n" or a single '\r', the length is without the line end. The
+           histogram has empty lines in bucket 0, lengths from 2^(i-1) to 2^i - 1 in
+           bucket i, the last bucket takes all longer lines.
+*/
+struct TTextStats {
+   std::uint64_t                 iBytes   = 0u;
+   std::uint64_t                 iLines   = 0u;
+   std::uint64_t                 iWords   = 0u;   ///< sequences without white space
+   std::uint64_t                 iLongest = 0u;   ///< length of the longest line
+   std::uint64_t                 iLF      = 0u;   ///< lines ending with '\n' only
+   std::uint64_t                 iCRLF    = 0u;
+   std::uint64_t                 iCR      = 0u;   ///< lines ending with '\r' only
+   std::array<std::uint64_t, 33> lengths  = { };  ///< histogram of the line lengths in log2 buckets
+   };
+
+TTextStats& operator += (TTextStats& sum, TTextStats const& val);
+
+/// fingerprint of the content of a file, 128 bit, not cryptographic
+struct TContentHash {
+   std::uint64_t iLow  = 0u;
+   std::uint64_t iHigh = 0u;
+
+   bool operator == (TContentHash const& other) const { return iLow == other.iLow && iHigh == other.iHigh; }
+   bool operator != (TContentHash const& other) const { return !(*this == other); }
+   bool operator <  (TContentHash const& other) const {
+      return iHigh < other.iHigh || (iHigh == other.iHigh && iLow < other.iLow);
+      }
+   };
+
+/// files with the same content, result of Find_Duplicates()
+struct TDuplicateGroup {
+   std::uintmax_t        iSize = 0u;
+   TContentHash          hash;
+   std::vector<fs::path> files;
+   };
+
+/// status of a file, result of the metadata stage
+struct TFileStatus {
+   bool           boValid     = false;
+   bool           boDirectory = false;
+   bool           boRegular   = false;
+   std::uintmax_t iSize       = 0u;
+   std::time_t    tWrite      = 0;
+   int            iError      = 0;
+   };
+
+/// thrown by the traversal when the running scan is cancelled with Scan_Control().Cancel()
+class TScanCancelled : public std::runtime_error {
+   public:
+      TScanCancelled() : std::runtime_error("scan cancelled") { }
+   };
+
+/// cancellation and progress of the running scan, written by the traversal, read by the ui
+class TScanControl {
+   public:
+      void Reset();
+      void Cancel() { boCancel.store(true, std::memory_order_relaxed); }
+      bool Cancelled() const { return boCancel.load(std::memory_order_relaxed); }
+      void Check() const { if(Cancelled()) throw TScanCancelled(); }
+
+      void Add_Dir() { iDirs.fetch_add(1u, std::memory_order_relaxed); }
+      void Add_Files(std::uint64_t iCount, std::uint64_t iSize = 0u) {
+         iFiles.fetch_add(iCount, std::memory_order_relaxed);
+         iBytes.fetch_add(iSize, std::memory_order_relaxed);
+         }
+
+      std::uint64_t Dirs() const  { return iDirs.load(std::memory_order_relaxed); }
+      std::uint64_t Files() const { return iFiles.load(std::memory_order_relaxed); }   ///< counted or matched files
+      std::uint64_t Bytes() const { return iBytes.load(std::memory_order_relaxed); }
+
+   private:
+      std::atomic<bool>          boCancel { false };
+      std::atomic<std::uint64_t> iDirs    { 0u };
+      std::atomic<std::uint64_t> iFiles   { 0u };
+      std::atomic<std::uint64_t> iBytes   { 0u };
+   };
+
+TScanControl& Scan_Control();
+
 std::uintmax_t Convert_Size_KiloByte(std::uintmax_t val);
 bool Is_Hidden(fs::path const& dir);
+void Set_Exclude_Patterns(std::vector<std::string> const& patterns);
+std::vector<std::string> Read_Exclude_File(fs::path const& file);
+void Set_Traversal_Threads(unsigned iThreads);
+unsigned Get_Traversal_Threads();
+void Set_Traversal_Memory(size_t iBytes);
+void Set_Traversal_Backend(ETraversalBackend eBackend);
+ETraversalBackend Get_Traversal_Backend();
 Dir_Stats_Type Count(fs::path const& dir, bool boWithSub = false);
+fs::path Snapshot_File(fs::path const& dir);
+Dir_Stats_Type Count_Snapshot(fs::path const& dir, fs::path const& snapshot_file, bool boFullRescan = false);
 size_t Find(std::vector<fs::path>& ret, fs::path const& dir, std::set<std::string> const& extensions, bool boWithSub = false);
+size_t Find_All(std::vector<fs::path>& ret, fs::path const& dir, bool boWithSub = false);
+size_t Find_Stream(fs::path const& dir, std::set<std::string> const& extensions, Find_Sink_Type const& sink,
+                   bool boWithSub = false, size_t iBatchSize = 256);
+void Set_Batched_Metadata(bool boBatched);
+std::vector<TFileStatus> Stat_Files(std::vector<fs::path> const& files);
+bool Set_Row_Kernel(ERowKernel eKernel);
+ERowKernel Get_Row_Kernel();
+size_t Count_Newlines(std::string_view text);
+TLineStats Classify_Lines(std::string_view text, ELineSyntax eSyntax);
+TContentHash Hash_Content(std::string_view text);
+TTextStats Text_Stats(std::string_view text);
+void Set_Map_Limit(size_t iBytes);
+void Set_Read_Mode(EReadMode eMode);
+EReadMode Get_Read_Mode();
+std::uint64_t Resident_Bytes(std::vector<fs::path> const& files);
+EContentKind Sniff_Content(std::string_view head);
+void Set_Binary_Policy(EBinaryPolicy ePolicy);
+EBinaryPolicy Get_Binary_Policy();
+bool Set_Decompression(bool boDecompress);
+bool Get_Decompression();
+bool Is_Compressed_Name(fs::path const& file);
 size_t CheckFileSize(fs::path const& strFile);
+std::vector<size_t> Count_Rows(std::vector<fs::path> const& files);
+std::vector<TLineStats> Count_Content(std::vector<fs::path> const& files);
+std::vector<TTextStats> Count_Text(std::vector<fs::path> const& files);
+fs::path Content_Cache_File(fs::path const& dir);
+std::vector<size_t> Count_Rows(std::vector<fs::path> const& files, fs::path const& cache_file);
+std::vector<TLineStats> Count_Lines(std::vector<fs::path> const& files, std::vector<ELineSyntax> const& syntax,
+                                    fs::path const& cache_file);
+std::vector<TLineStats> Count_Lines(std::vector<fs::path> const& files, std::vector<ELineSyntax> const& syntax,
+                                    fs::path const& cache_file, std::vector<TTextStats>& text);
+std::vector<TDuplicateGroup> Find_Duplicates(std::vector<fs::path> const& files, fs::path const& cache_file);
+
+/**
+  \brief fs::weakly_canonical() with the resolved directories kept, for many files in few directories
+  \details a directory is resolved from its resolved parent, so every directory costs one
+           lstat for the whole lifetime and a file one more (a link is resolved completely).
+           The results are those of weakly_canonical(), it may be used by several threads.
+*/
+class TPathResolver {
+   public:
+      TPathResolver();
+      TPathResolver(TPathResolver const&) = delete;
+      ~TPathResolver();
+
+      fs::path Resolve(fs::path const& file);
+
+   private:
+      struct TImpl;
+      std::unique_ptr<TImpl> impl;
+   };
+
+/**
+  \brief private, writable copy of the content of a file, for parsers which work in place
+  \details on linux a private mapping of the file, only the pages which the parser
+           changes are copied. Other systems read the file into a buffer. When another
+           process truncates the file under the mapping, the missing pages are read as
+           zeros and Check() throws a filesystem_error; the copy belongs to the thread
+           which creates it.
+*/
+class TFileCopy {
+   public:
+      explicit TFileCopy(fs::path const& file);
+      TFileCopy(TFileCopy const&) = delete;
+      ~TFileCopy();
+
+      char*  data() { return view; }
+      size_t size() const { return iSize; }
+      void   Check() const;
+
+   private:
+      class TGuard;
+      fs::path                path;
+      char*                   view     = nullptr;
+      size_t                  iSize    = 0u;
+      bool                    boMapped = false;
+      std::vector<char>       buffer;
+      std::unique_ptr<TGuard> guard;
+   };
+
+size_t Cut_After_ItemGroup(char* data, size_t iSize);
+
+
+/**
+  \brief subtotals of all directories of a tree, result of Count_Tree()
+  \details flat array of nodes in breadth first order, the children of a node
+           are consecutive and follow their parent, names are kept in one pool
+*/
+class TDirTree {
+   friend Dir_Stats_Type Count_Tree(fs::path const& dir, TDirTree& tree, size_t iTopFiles);
+   public:
+      static constexpr size_t npos = static_cast<size_t>(-1);
+
+      size_t         Size() const { return nodes.size(); }
+      fs::path       Path(size_t idx) const;
+      size_t         Parent(size_t idx) const;
+      size_t         First_Child(size_t idx) const { return nodes[idx].iFirstChild; }
+      size_t         Children(size_t idx) const { return nodes[idx].iChildren; }
+      Dir_Stats_Type Own(size_t idx) const;     ///< direct entries of the directory (exclusive)
+      Dir_Stats_Type Total(size_t idx) const;   ///< directory with its subtree (inclusive)
+
+      std::vector<size_t> Top_Directories(size_t iCount) const;
+      std::vector<std::pair<fs::path, std::uintmax_t>> const& Top_Files() const { return top_files; }
+
+   private:
+      struct TNode {
+         std::uint32_t iParent     = 0u;
+         std::uint32_t iName       = 0u;   // offset in names
+         std::uint32_t iFirstChild = 0u;
+         std::uint32_t iChildren   = 0u;
+         std::uint32_t iOwnFiles   = 0u;
+         std::uint32_t iOwnDirs    = 0u;
+         std::uint32_t iFiles      = 0u;
+         std::uint32_t iDirs       = 0u;
+         std::uint64_t iOwnSize    = 0u;
+         std::uint64_t iSize       = 0u;
+         };
+
+      fs::path                                         root;
+      std::vector<TNode>                               nodes;
+      std::string                                      names;     // '\0' separated
+      std::vector<std::pair<fs::path, std::uintmax_t>> top_files; // largest first
+   };
+
+Dir_Stats_Type Count_Tree(fs::path const& dir, TDirTree& tree, size_t iTopFiles = 0u);
+
+
+/// live mode for Count(), keeps the totals of a directory tree current with inotify
+class TCountWatcher {
+   public:
+      TCountWatcher();
+      TCountWatcher(TCountWatcher const&) = delete;
+      ~TCountWatcher();
+
+      Dir_Stats_Type Start(fs::path const& root);
+      void           Stop();
+      bool           Update(std::chrono::milliseconds rescan_interval = std::chrono::seconds(60));
+
+      bool           Active() const;
+      Dir_Stats_Type Totals() const;
+      size_t         Unwatched() const;
+
+   private:
+      struct TImpl;
+      std::unique_ptr<TImpl> impl;
+   };
 
 
 #endif
@@ -0,0 +1,210 @@
+//---------------------------------------------------------------------------
+
+#ifndef FileUtilInternalH
+#define FileUtilInternalH
+//---------------------------------------------------------------------------
+// parts of the file utilities which the modules share among each other, not
+// for the users of FileUtil.h. The modules:
+//    FileUtil.cpp        common values, scan control, temporary and cache files
+//    FileWalk.cpp        hidden directories, exclusion, traversal, metadata, subtotals
+//    FileSnapshot.cpp    snapshot for the incremental Count
+//    FileWatch.cpp       live mode with inotify
+//    FileKernels.cpp     row counting, line classification and wc statistic with SIMD
+//    FileHash.cpp        fingerprint of the content
+//    FileDecompress.cpp  gzip and zstd, only with FILEAPP_WITH_ZLIB / FILEAPP_WITH_ZSTD
+//    FileContent.cpp     content reader with its read modes and the count of a file
+//    FileProject.cpp     files of the projects for the parsers in Process.cpp
+//    FileCache.cpp       persistent content cache, pool of the counters, duplicates
+//---------------------------------------------------------------------------
+#include "FileUtil.h"
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <functional>
+#include <cstdint>
+#include <cerrno>
+
+#if defined(__linux__)
+   #include <csignal>
+#endif
+
+
+//----------------------------------------------------------------------------
+// FileUtil.cpp
+
+[[noreturn]] void Raise_File_Error(char const* what, fs::path const& file, int err);
+fs::path Create_Temp_File(fs::path const& file);
+fs::path Cache_Directory();
+
+
+//----------------------------------------------------------------------------
+// FileWalk.cpp
+
+class TExclusion;
+
+/// filter for one scan: hidden directories and user patterns relative to the root
+class TScanFilter {
+   public:
+      TScanFilter(fs::path const& root);
+
+      bool Active() const;
+      std::string const& Signature() const;
+
+      /// part of a directory below the root for Excluded(), once for all entries of the directory
+      std::string Relative(fs::path const& dir) const;
+
+      /// directory isn't counted and not opened, rel_dir from Relative()
+      bool Excluded(std::string_view rel_dir, std::string_view name, bool boDirectory) const;
+
+      /// directory is counted, but not opened
+      static bool Hidden(std::string_view name);
+
+   private:
+      std::shared_ptr<const TExclusion> patterns;
+      size_t                            iRootLength;
+   };
+
+/// entry of a directory for the walks outside of the traversal, the same for both backends
+class TDirEntry {
+   public:
+      virtual ~TDirEntry() = default;
+      virtual std::string_view filename() const = 0;
+      virtual bool             is_directory() const = 0;
+      virtual std::uintmax_t   file_size() const = 0;
+   };
+
+using Dir_Entry_Func = std::function<void (TDirEntry const&)>;
+
+void Read_Entries(fs::path const& dir, Dir_Entry_Func const& func);
+
+#if defined(__linux__)
+int Open_Directory(fs::path const& dir);
+#endif
+
+
+//----------------------------------------------------------------------------
+// FileKernels.cpp
+
+/// Classify_Lines() for a content which comes in blocks
+class TLineStream {
+   public:
+      explicit TLineStream(ELineSyntax eSyntax);
+      TLineStream(TLineStream const&) = delete;
+      ~TLineStream();
+
+      void       Feed(std::string_view block);
+      TLineStats Finish();
+
+   private:
+      struct TImpl;
+      std::unique_ptr<TImpl> impl;
+   };
+
+/// Text_Stats() for a content which comes in blocks
+class TTextStream {
+   public:
+      TTextStream();
+      TTextStream(TTextStream const&) = delete;
+      ~TTextStream();
+
+      void       Feed(std::string_view block);
+      TTextStats Finish();
+
+   private:
+      struct TImpl;
+      std::unique_ptr<TImpl> impl;
+   };
+
+
+//----------------------------------------------------------------------------
+// FileHash.cpp
+
+/// Hash_Content() for a content which comes in blocks of any size
+class TContentHasher {
+   public:
+      TContentHasher();
+
+      void         Update(std::string_view data);
+      TContentHash Final() const;
+
+   private:
+      void Stripe(unsigned char const* data);
+
+      std::uint64_t lanes[4];
+      unsigned char buffer[32];
+      size_t        iBuffered = 0u;
+      std::uint64_t iLength   = 0u;
+   };
+
+
+//----------------------------------------------------------------------------
+// FileDecompress.cpp
+
+enum class ECompression : int { none, gzip, zstd };
+
+ECompression Compression_Of(std::string_view head);
+
+/// streaming decompression of gzip (also concatenated members) or zstd (also several frames)
+class TDecompressor {
+   public:
+      using Window_Func = std::function<void (std::string_view)>;
+
+      explicit TDecompressor(ECompression eFormat);
+      TDecompressor(TDecompressor const&) = delete;
+      ~TDecompressor();
+
+      /// decompress the block, func gets the content window by window
+      void Feed(std::string_view block, Window_Func const& func);
+      void Finish() const;
+
+   private:
+      struct TImpl;
+      std::unique_ptr<TImpl> impl;
+   };
+
+
+//----------------------------------------------------------------------------
+// FileContent.cpp
+
+#if defined(__linux__)
+/**
+  \brief protection of a mapped file against the truncation by another process
+  \details an access behind the new end of the file raises SIGBUS. The handler looks for
+           the address in the guards of the thread, maps zeros from the page of the fault
+           to the end of the view and marks the guard, so the access is repeated and the
+           owner throws a filesystem_error after the block with Check(). Faults outside the
+           guards go to the former handler. A guard belongs to the thread which creates it.
+*/
+class TMapGuard {
+   public:
+      TMapGuard(void* view, size_t iSize, int iProtection);
+      TMapGuard(TMapGuard const&) = delete;
+      ~TMapGuard();
+
+      void Check(fs::path const& file) const {
+         if(boFault) Raise_File_Error("file truncated while it was read", file, EIO);
+         }
+
+   private:
+      static void Handler(int iSignal, siginfo_t* info, void* context);
+
+      char*                 begin;
+      char*                 end;
+      size_t                iPage;
+      int                   iAccess;
+      volatile sig_atomic_t boFault = 0;
+      TMapGuard*            next;
+
+      static thread_local TMapGuard* guards;
+      static struct sigaction        former;
+   };
+#endif
+
+bool Is_Skipped(EContentKind eKind, EBinaryPolicy ePolicy);
+bool Is_Decoded(EContentKind eKind, EBinaryPolicy ePolicy);
+TLineStats Count_File(fs::path const& file, ELineSyntax const* syntax, EBinaryPolicy ePolicy, bool boInflate,
+                      TContentHasher* hasher, TTextStats* text, bool boReadAll, std::uint64_t& iBytes);
+bool Same_Content(fs::path const& lhs, fs::path const& rhs);
+
+#endif
@@ -0,0 +1,1471 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include "FileUtil.h"
+#include "FileUtilInternal.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <iterator>
+#include <cstdio>
+#include <atomic>
+#include <exception>
+#include <utility>
+#include <type_traits>
+#include <system_error>
+#include <limits>
+#include <cerrno>
+#include <ctime>
+
+#if defined(__linux__)
+   #include <fcntl.h>
+   #include <unistd.h>
+   #include <sys/stat.h>
+   #include <sys/syscall.h>
+   #include <dirent.h>
+   #include <climits>
+#endif
+//---------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+// hidden directories, perfect hash over length and first / last character,
+// the seed is searched by the compiler, lookup without allocation
+namespace {
+
+constexpr std::string_view hidden_names[] = { "__history", "__astcache", "__recovery",
+                                              ".git", ".svn", ".vs", "win32", "win64" };
+constexpr size_t iHiddenSlots = 16u;
+
+constexpr char Lower_Char(char c) {
+   return c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a') : c;
+   }
+
+constexpr size_t Hidden_Hash(std::string_view name, size_t seed) {
+   return (name.size() * seed + static_cast<unsigned char>(Lower_Char(name.front())) * 31u +
+           static_cast<unsigned char>(Lower_Char(name.back()))) % iHiddenSlots;
+   }
+
+constexpr size_t Find_Hidden_Seed() {
+   for(size_t seed = 1u; seed < 1000u; ++seed) {
+      bool used[iHiddenSlots] = { };
+      bool boPerfect = true;
+      for(auto name : hidden_names) {
+         auto slot = Hidden_Hash(name, seed);
+         if(used[slot]) { boPerfect = false; break; }
+         used[slot] = true;
+         }
+      if(boPerfect) return seed;
+      }
+   return 0u;
+   }
+
+constexpr size_t iHiddenSeed = Find_Hidden_Seed();
+static_assert(iHiddenSeed != 0u, "no perfect hash for the hidden directories");
+
+struct THiddenTable {
+   std::string_view slots[iHiddenSlots] = { };
+   };
+
+constexpr THiddenTable Build_Hidden_Table() {
+   THiddenTable table;
+   for(auto name : hidden_names) table.slots[Hidden_Hash(name, iHiddenSeed)] = name;
+   return table;
+   }
+
+constexpr THiddenTable hidden_table = Build_Hidden_Table();
+
+/// case insensitive check of a directory name against the list of hidden directories
+constexpr bool Is_Hidden_Name(std::string_view name) {
+   if(name.empty()) return false;
+   auto const& slot = hidden_table.slots[Hidden_Hash(name, iHiddenSeed)];
+   if(slot.size() != name.size()) return false;
+   for(size_t i = 0u; i < name.size(); ++i) {
+      if(Lower_Char(name[i]) != slot[i]) return false;
+      }
+   return true;
+   }
+
+static_assert(Is_Hidden_Name(".GIT") && Is_Hidden_Name("Win64") && !Is_Hidden_Name("src"), "hidden table broken");
+
+} // end of anonymous namespace
+
+
+//----------------------------------------------------------------------------
+// exclusion with gitignore- style patterns, compiled once and used for the
+// whole scan. Rules: '#' comment, '!' negation, trailing '/' only directories,
+// a '/' at the beginning or in the middle anchors the pattern at the root,
+// '*', '?', '[...]' inside a name, '**' for any count of directories.
+// The last matching pattern wins. A path is matched in place, as directory
+// relative to the root and name of the entry, without copies of its parts.
+class TExclusion {
+   public:
+      TExclusion(std::vector<std::string> const& patterns) {
+         for(auto const& pattern : patterns) Compile(pattern);
+         }
+
+      bool Empty() const { return rules.empty(); }
+      std::string const& Signature() const { return strSignature; }
+
+      /// entry name in the directory rel_dir, relative to the root of the scan with '/' as separator
+      bool Excluded(std::string_view rel_dir, std::string_view name, bool boDirectory) const {
+         if(name.empty()) return false;
+         bool boExcluded = false;
+         for(auto const& rule : rules) {
+            if(rule.boDirOnly && !boDirectory) continue;
+            if(rule.boNegate != boExcluded) continue;   // can't change the result
+            const bool boMatch = rule.boAnchored ? Match_Segments(rule.segments, 0u, TParts { rel_dir, name })
+                                                 : Match_Segment(rule.segments.front(), name);
+            if(boMatch) boExcluded = !rule.boNegate;
+            }
+         return boExcluded;
+         }
+
+   private:
+      /// part of a pattern between two '/', names without wildcards are compared directly
+      struct TSegment {
+         std::string strText;
+         bool        boLiteral = false;
+         bool        boAnyDirs = false;   ///< "**"
+         };
+
+      struct TRule {
+         std::vector<TSegment> segments;
+         bool boNegate   = false;
+         bool boDirOnly  = false;
+         bool boAnchored = false;
+         };
+
+      /// the parts of the directory and then the name, a copy is a position for the backtracking of "**"
+      struct TParts {
+         std::string_view dir;
+         std::string_view name;
+
+         bool Empty() const {
+            return name.empty() && dir.find_first_not_of('/') == std::string_view::npos;
+            }
+
+         std::string_view Next() {
+            const auto pos = dir.find_first_not_of('/');
+            if(pos == std::string_view::npos) {
+               dir = std::string_view();
+               return std::exchange(name, std::string_view());
+               }
+            const auto end = std::min(dir.find('/', pos), dir.size());
+            const auto part = dir.substr(pos, end - pos);
+            dir.remove_prefix(end);
+            return part;
+            }
+         };
+
+      void Compile(std::string pattern) {
+         while(!pattern.empty() && (pattern.back() == ' ' || pattern.back() == '\r')) pattern.pop_back();
+         if(pattern.empty() || pattern.front() == '#') return;
+         strSignature += pattern;
+         strSignature += '\n';
+
+         TRule rule;
+         if(pattern.front() == '!') { rule.boNegate = true; pattern.erase(0, 1); }
+         else if(pattern.front() == '\\') pattern.erase(0, 1);   // "\#" or "\!"
+         if(!pattern.empty() && pattern.back() == '/') { rule.boDirOnly = true; pattern.pop_back(); }
+         if(pattern.empty()) return;
+
+         rule.boAnchored = pattern.find('/') != std::string::npos;
+         if(pattern.front() == '/') pattern.erase(0, 1);
+         for(size_t pos = 0u; pos <= pattern.size(); ) {
+            auto end = pattern.find('/', pos);
+            if(end == std::string::npos) end = pattern.size();
+            if(end > pos) {
+               TSegment segment;
+               segment.strText   = pattern.substr(pos, end - pos);
+               segment.boAnyDirs = segment.strText == "**";
+               segment.boLiteral = segment.strText.find_first_of("*?[\\") == std::string::npos;
+               if(!(segment.boAnyDirs && !rule.segments.empty() && rule.segments.back().boAnyDirs))
+                  rule.segments.emplace_back(std::move(segment));
+               }
+            pos = end + 1u;
+            }
+         if(!rule.segments.empty()) rules.emplace_back(std::move(rule));
+         }
+
+      static bool Match_Segment(TSegment const& segment, std::string_view name) {
+         if(!segment.boLiteral) return Match_Glob(segment.strText, name);
+         if(segment.strText.size() != name.size()) return false;
+      #if defined(_WIN32)
+         return std::equal(name.begin(), name.end(), segment.strText.begin(),
+                           [](char a, char b) { return Lower_Char(a) == Lower_Char(b); });
+      #else
+         return name == segment.strText;
+      #endif
+         }
+
+      /// name against a pattern without '/', backtracking for '*'
+      static bool Match_Glob(std::string_view pattern, std::string_view name) {
+         size_t p = 0u, n = 0u, star_p = std::string_view::npos, star_n = 0u;
+         while(n < name.size()) {
+            if(p < pattern.size() && pattern[p] == '*') { star_p = p++; star_n = n; continue; }
+            if(p < pattern.size()) {
+               size_t next = p;
+               if(Match_Char(pattern, next, name[n])) { p = next; ++n; continue; }
+               }
+            if(star_p == std::string_view::npos) return false;
+            p = star_p + 1u;
+            n = ++star_n;
+            }
+         while(p < pattern.size() && pattern[p] == '*') ++p;
+         return p == pattern.size();
+         }
+
+      /// one element of the pattern ('?', '[...]', '\x' or char) at pos, pos is moved behind it
+      static bool Match_Char(std::string_view pattern, size_t& pos, char c) {
+         auto equal = [](char a, char b) {
+         #if defined(_WIN32)
+            return Lower_Char(a) == Lower_Char(b);
+         #else
+            return a == b;
+         #endif
+            };
+         switch(pattern[pos]) {
+            case '?': ++pos; return true;
+            case '\\':
+               if(pos + 1u < pattern.size()) { pos += 2u; return equal(pattern[pos - 1u], c); }
+               ++pos;
+               return equal('\\', c);
+            case '[': {
+               size_t i = pos + 1u;
+               bool boInvert = i < pattern.size() && (pattern[i] == '!' || pattern[i] == '^');
+               if(boInvert) ++i;
+               bool boFound = false;
+               size_t first = i;
+               for(; i < pattern.size() && (pattern[i] != ']' || i == first); ++i) {
+                  if(i + 2u < pattern.size() && pattern[i + 1u] == '-' && pattern[i + 2u] != ']') {
+                     if(pattern[i] <= c && c <= pattern[i + 2u]) boFound = true;
+                     i += 2u;
+                     }
+                  else if(equal(pattern[i], c)) boFound = true;
+                  }
+               if(i >= pattern.size()) { ++pos; return c == '['; }   // no closing bracket, literal
+               pos = i + 1u;
+               return boFound != boInvert;
+               }
+            default: return equal(pattern[pos++], c);
+            }
+         }
+
+      static bool Match_Segments(std::vector<TSegment> const& segments, size_t s, TParts parts) {
+         for(; s < segments.size(); ++s) {
+            if(segments[s].boAnyDirs) {
+               if(s + 1u == segments.size()) return !parts.Empty();   // "dir/**" everything inside
+               for(; !parts.Empty(); parts.Next()) {
+                  if(Match_Segments(segments, s + 1u, parts)) return true;
+                  }
+               return false;
+               }
+            if(parts.Empty() || !Match_Segment(segments[s], parts.Next())) return false;
+            }
+         return parts.Empty();
+         }
+
+      std::vector<TRule> rules;
+      std::string        strSignature;
+   };
+
+namespace {
+
+std::mutex                        mtxExclusion;
+std::shared_ptr<const TExclusion> exclusion = std::make_shared<const TExclusion>(std::vector<std::string> { });
+
+std::shared_ptr<const TExclusion> Current_Exclusion() {
+   std::lock_guard<std::mutex> lock(mtxExclusion);
+   return exclusion;
+   }
+
+} // end of anonymous namespace
+
+
+TScanFilter::TScanFilter(fs::path const& root) : patterns(Current_Exclusion()), iRootLength(root.generic_string().size()) { }
+
+bool TScanFilter::Active() const {
+   return !patterns->Empty();
+   }
+
+std::string const& TScanFilter::Signature() const {
+   return patterns->Signature();
+   }
+
+std::string TScanFilter::Relative(fs::path const& dir) const {
+   if(patterns->Empty()) return { };
+   std::string strPath = dir.generic_string();
+   strPath.erase(0, std::min(iRootLength, strPath.size()));
+   return strPath;
+   }
+
+bool TScanFilter::Excluded(std::string_view rel_dir, std::string_view name, bool boDirectory) const {
+   return !patterns->Empty() && patterns->Excluded(rel_dir, name, boDirectory);
+   }
+
+bool TScanFilter::Hidden(std::string_view name) {
+   return Is_Hidden_Name(name);
+   }
+
+
+bool Is_Hidden(fs::path const& dir) {
+   if(!fs::is_directory(dir)) return false;
+   return Is_Hidden_Name(dir.filename().string());
+   }
+
+/// patterns for all following scans, see TExclusion for the rules
+void Set_Exclude_Patterns(std::vector<std::string> const& patterns) {
+   auto compiled = std::make_shared<const TExclusion>(patterns);
+   std::lock_guard<std::mutex> lock(mtxExclusion);
+   exclusion = std::move(compiled);
+   }
+
+/// patterns from a file with the syntax of .gitignore, empty if the file doesn't exist
+std::vector<std::string> Read_Exclude_File(fs::path const& file) {
+   std::vector<std::string> ret;
+   std::ifstream ifs(file);
+   for(std::string strLine; std::getline(ifs, strLine); ) ret.emplace_back(std::move(strLine));
+   return ret;
+   }
+
+
+
+//----------------------------------------------------------------------------
+// traversal of directory trees
+namespace {
+
+unsigned iTraversalThreads = std::max(1u, std::thread::hardware_concurrency());
+size_t   iTraversalMemory  = 64u * 1024u * 1024u;
+#if defined(__linux__)
+ETraversalBackend eTraversalBackend = ETraversalBackend::native;
+#else
+ETraversalBackend eTraversalBackend = ETraversalBackend::filesystem;
+#endif
+
+
+/// extension of a filename with the same rules as fs::path::extension()
+std::string_view Extension_Of(std::string_view name) {
+   if(name == "." || name == "..") return { };
+   auto pos = name.rfind('.');
+   if(pos == std::string_view::npos || pos == 0u) return { };
+   return name.substr(pos);
+   }
+
+
+/// entry of a directory, read with std::filesystem (portable backend)
+class TFsEntry {
+   public:
+      TFsEntry(fs::directory_entry const& e) : entry(e), strName(e.path().filename().string()) { }
+      std::string_view filename() const { return strName; }
+      bool is_directory() const { return entry.is_directory(); }
+      std::uintmax_t file_size() const { return entry.file_size(); }
+      fs::path const& path() const { return entry.path(); }
+
+   private:
+      fs::directory_entry const& entry;
+      std::string strName;
+   };
+
+template <typename func_type>
+void Read_Filesystem(fs::path const& dir, func_type func) {
+   auto const& control = Scan_Control();
+   for(auto const& entry : fs::directory_iterator(dir)) {
+      control.Check();
+      func(TFsEntry(entry));
+      }
+   }
+
+
+//----------------------------------------------------------------------------
+// metadata stage, status of many files with one call. A pool of threads calls
+// stat in parallel. Important for network drives, where the latency of the
+// single calls dominates. Off by default, on local disks with a warm cache the
+// synchronous calls measured faster, switch on for network drives. statx with
+// io_uring was slower than the pool behind a file system with latency, the
+// kernel runs the blocking statx in its own workers anyway.
+bool boBatchedMetadata = false;
+const size_t iMinBatch = 32u;   // smaller directories synchronous, the setup of the batch costs more
+
+/// pool of threads for the fallback, the calling thread works too
+class TStatPool {
+   public:
+      static TStatPool& Instance() {
+         static TStatPool pool;
+         return pool;
+         }
+
+      /// call func(i) for all i in [0, n), returns when all are finished
+      template <typename func_type>
+      void For_Each(size_t n, func_type func) {
+         const size_t iChunk = 16u;
+         if(n <= iChunk || workers.empty()) {
+            for(size_t i = 0u; i < n; ++i) func(i);
+            return;
+            }
+         std::atomic<size_t> next { 0u };
+         std::atomic<size_t> open_tasks { 0u };
+         std::mutex mtxDone;
+         std::condition_variable cvDone;
+         auto work = [&]() {
+                  for(size_t start; (start = next.fetch_add(iChunk)) < n; ) {
+                     for(size_t i = start; i < std::min(n, start + iChunk); ++i) func(i);
+                     }
+                  };
+         const size_t iTasks = std::min(workers.size(), n / iChunk);
+         open_tasks = iTasks;
+         {
+         std::lock_guard<std::mutex> lock(mtx);
+         for(size_t i = 0u; i < iTasks; ++i) tasks.emplace_back([&]() {
+                  work();
+                  std::lock_guard<std::mutex> lock_done(mtxDone);
+                  if(--open_tasks == 0u) cvDone.notify_one();
+                  });
+         }
+         cv.notify_all();
+         work();
+         std::unique_lock<std::mutex> lock(mtxDone);
+         cvDone.wait(lock, [&open_tasks]() { return open_tasks == 0u; });
+         }
+
+   private:
+      TStatPool() {
+         const unsigned iThreads = std::max(4u, std::thread::hardware_concurrency() * 2u);
+         for(unsigned i = 0u; i < iThreads; ++i) workers.emplace_back([this]() { Run(); });
+         }
+
+      ~TStatPool() {
+         { std::lock_guard<std::mutex> lock(mtx); boStop = true; }
+         cv.notify_all();
+         for(auto& worker : workers) worker.join();
+         }
+
+      void Run() {
+         for(;;) {
+            std::function<void ()> task;
+            {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [this]() { return boStop || !tasks.empty(); });
+            if(tasks.empty()) return;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+            }
+            task();
+            }
+         }
+
+      std::vector<std::thread>           workers;
+      std::deque<std::function<void ()>> tasks;
+      std::mutex                         mtx;
+      std::condition_variable            cv;
+      bool                               boStop = false;
+   };
+
+
+#if defined(__linux__)
+void Fill_Status(TFileStatus& status, struct ::stat const& st) {
+   status.boValid     = true;
+   status.boDirectory = S_ISDIR(st.st_mode);
+   status.boRegular   = S_ISREG(st.st_mode);
+   status.iSize       = static_cast<std::uintmax_t>(st.st_size);
+   status.tWrite      = st.st_mtim.tv_sec;
+   status.iError      = 0;
+   }
+
+void Stat_One(int iDirFd, char const* name, TFileStatus& status) {
+   struct ::stat st;
+   if(::fstatat(iDirFd, name, &st, 0) == 0) Fill_Status(status, st);
+   else {
+      status = TFileStatus { };
+      status.iError = errno;
+      }
+   }
+
+/// status for all names relative to the directory (AT_FDCWD for absolute or relative paths)
+void Stat_Batch(int iDirFd, std::vector<char const*> const& names, std::vector<TFileStatus>& result) {
+   result.resize(names.size());
+   if(boBatchedMetadata && names.size() >= iMinBatch) {
+      TStatPool::Instance().For_Each(names.size(), [&](size_t i) { Stat_One(iDirFd, names[i], result[i]); });
+      }
+   else {
+      for(size_t i = 0u; i < names.size(); ++i) Stat_One(iDirFd, names[i], result[i]);
+      }
+   }
+#else
+std::time_t To_Time_t(fs::file_time_type ftime) {
+#if (defined(_MSVC_LANG) && _MSVC_LANG < 202002L)
+   // offset between the epoch of the file clock and 1.1.1970
+   auto constexpr __std_fs_file_time_epoch_adjustment = 0x19DB1DED53E8000LL;
+   constexpr fs::file_time_type::duration adjustment(__std_fs_file_time_epoch_adjustment);
+   return std::chrono::duration_cast<std::chrono::seconds>(ftime.time_since_epoch() - adjustment).count();
+#else
+   return decltype(ftime)::clock::to_time_t(ftime);
+#endif
+   }
+
+void Stat_One(fs::path const& file, TFileStatus& status) {
+   status = TFileStatus { };
+   std::error_code ec;
+   auto type = fs::status(file, ec);
+   if(ec) { status.iError = ec.value(); return; }
+   status.boValid     = true;
+   status.boDirectory = fs::is_directory(type);
+   status.boRegular   = fs::is_regular_file(type);
+   if(status.boRegular) status.iSize = fs::file_size(file, ec);
+   if(auto ftime = fs::last_write_time(file, ec); !ec) status.tWrite = To_Time_t(ftime);
+   }
+#endif
+
+
+#if defined(__linux__)
+/// layout of the records returned by getdents64
+struct TLinuxDirent64 {
+   std::uint64_t  d_ino;
+   std::int64_t   d_off;
+   unsigned short d_reclen;
+   unsigned char  d_type;
+   char           d_name[1];
+   };
+
+/// entry of a directory, read with getdents64 relative to the open directory,
+/// stat only when d_type is missing or for the size, path only when requested
+class TNativeEntry {
+   public:
+      TNativeEntry(int fd, fs::path const& dir, std::string_view name, unsigned char type,
+                   TFileStatus const* prefetched = nullptr) :
+                   iDirFd(fd), parent(dir), strName(name), iType(type) {
+         if(prefetched) { status = *prefetched; boStat = true; }
+         }
+
+      std::string_view filename() const { return strName; }
+
+      bool is_directory() const {
+         if(iType == DT_DIR) return true;
+         if(iType != DT_UNKNOWN && iType != DT_LNK && !boStat) return false;
+         return Stat().boValid && status.boDirectory;
+         }
+
+      std::uintmax_t file_size() const {
+         if(!Stat().boValid) Raise(status.iError);
+         if(status.boDirectory) Raise(EISDIR);
+         if(!status.boRegular) Raise(ENOTSUP);
+         return status.iSize;
+         }
+
+      fs::path path() const { return parent / fs::path(strName); }
+
+   private:
+      TFileStatus const& Stat() const {
+         if(!boStat) {
+            Stat_One(iDirFd, strName.data(), status);
+            boStat = true;
+            }
+         return status;
+         }
+
+      [[noreturn]] void Raise(int err) const {
+         throw fs::filesystem_error("cannot get file size", path(), std::error_code(err, std::generic_category()));
+         }
+
+      int                  iDirFd;
+      fs::path const&      parent;
+      std::string_view     strName;     // terminated with '\0'
+      unsigned char        iType;
+      mutable TFileStatus  status;
+      mutable bool         boStat = false;
+   };
+
+} // end of anonymous namespace
+
+/// open a directory, paths longer than PATH_MAX (deep trees) are opened in parts with openat
+int Open_Directory(fs::path const& dir) {
+   constexpr int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+   int fd = ::open(dir.c_str(), flags);
+   if(fd >= 0 || errno != ENAMETOOLONG) return fd;
+
+   std::string const& strDir = dir.native();
+   int current = AT_FDCWD;
+   for(size_t pos = 0u; pos < strDir.size(); ) {
+      size_t end = std::min(strDir.size(), pos + PATH_MAX - 1u);
+      if(end < strDir.size()) {
+         auto slash = strDir.rfind('/', end);
+         if(slash == std::string::npos || slash <= pos) {
+            if(current != AT_FDCWD) ::close(current);
+            errno = ENAMETOOLONG;
+            return -1;
+            }
+         end = slash;
+         }
+      const std::string strPart = strDir.substr(pos, end - pos);
+      const int next = ::openat(current, strPart.empty() ? "/" : strPart.c_str(), flags);
+      const int err = errno;
+      if(current != AT_FDCWD) ::close(current);
+      if(next < 0) { errno = err; return -1; }
+      current = next;
+      pos = end + 1u;
+      }
+   return current;
+   }
+
+namespace {
+
+/// with boSizes all entries, which aren't known as directories, are collected and
+/// get their status with one batch after reading the directory
+template <typename func_type>
+void Read_Native(fs::path const& dir, func_type func, bool boSizes) {
+   struct TDirHandle {
+      int fd;
+      ~TDirHandle() { if(fd >= 0) ::close(fd); }
+      } handle { Open_Directory(dir) };
+
+   auto raise = [&dir](int err) {
+          throw fs::filesystem_error("directory iterator cannot open directory", dir,
+                                     std::error_code(err, std::generic_category()));
+          };
+
+   if(handle.fd < 0) raise(errno);
+   std::string names;                                       // names of the collected entries, '\0' separated
+   std::vector<std::pair<size_t, unsigned char>> pending;   // offset in names, d_type
+   alignas(TLinuxDirent64) char buffer[32 * 1024];
+   auto const& control = Scan_Control();
+   for(;;) {
+      control.Check();
+      auto iRead = ::syscall(SYS_getdents64, handle.fd, buffer, sizeof(buffer));
+      if(iRead < 0) raise(errno);
+      if(iRead == 0) break;
+      for(long pos = 0; pos < iRead; ) {
+         auto const* ent = reinterpret_cast<TLinuxDirent64 const*>(buffer + pos);
+         pos += ent->d_reclen;
+         std::string_view name(ent->d_name);
+         if(name == "." || name == "..") continue;
+         if(!boSizes || ent->d_type == DT_DIR) func(TNativeEntry(handle.fd, dir, name, ent->d_type));
+         else {
+            pending.emplace_back(names.size(), ent->d_type);
+            names.append(name);
+            names.push_back('\0');
+            }
+         }
+      }
+
+   if(!pending.empty()) {
+      std::vector<char const*> pointers;
+      pointers.reserve(pending.size());
+      for(auto const& [offset, type] : pending) pointers.emplace_back(names.data() + offset);
+      std::vector<TFileStatus> status;
+      Stat_Batch(handle.fd, pointers, status);
+      for(size_t i = 0u; i < pending.size(); ++i)
+         func(TNativeEntry(handle.fd, dir, pointers[i], pending[i].second, &status[i]));
+      }
+   }
+#endif
+
+/// call func for every entry in dir with the selected backend, all walks pass here,
+/// so this is the point for the cancellation and the count of the visited directories
+template <typename func_type>
+void Read_Directory(fs::path const& dir, func_type func, bool boSizes = false) {
+   Scan_Control().Check();
+#if defined(__linux__)
+   if(eTraversalBackend == ETraversalBackend::native) Read_Native(dir, func, boSizes);
+   else Read_Filesystem(dir, func);
+#else
+   (void)boSizes;
+   Read_Filesystem(dir, func);
+#endif
+   Scan_Control().Add_Dir();
+   }
+
+/// progress of the files of one directory, difference of the values before and after reading it
+void Add_Progress(Dir_Stats_Type const& before, Dir_Stats_Type const& after) {
+   Scan_Control().Add_Files(std::get<0>(after) - std::get<0>(before), std::get<2>(after) - std::get<2>(before));
+   }
+
+
+/// stack of pending directories for the iterative traversal, above the budget the
+/// lower half is moved to a temporary file and read back when the stack is empty.
+/// Pop_Front() takes the oldest directory in memory, for the stealing of the parallel walk
+class TDirStack {
+   public:
+      TDirStack(size_t budget) : iBudget(budget) { }
+      TDirStack(TDirStack const&) = delete;
+      ~TDirStack() { if(spill) std::fclose(spill); }
+
+      bool Empty() const { return dirs.empty() && chunks.empty(); }
+
+      void Push(fs::path dir) {
+         iBytes += Bytes(dir);
+         dirs.emplace_back(std::move(dir));
+         if(iBytes > iBudget && dirs.size() > 1u) Spill();
+         }
+
+      fs::path Pop() {
+         if(dirs.empty()) Reload();
+         fs::path ret = std::move(dirs.back());
+         dirs.pop_back();
+         iBytes -= Bytes(ret);
+         return ret;
+         }
+
+      fs::path Pop_Front() {
+         if(dirs.empty()) Reload();
+         fs::path ret = std::move(dirs.front());
+         dirs.pop_front();
+         iBytes -= Bytes(ret);
+         return ret;
+         }
+
+   private:
+      using char_type = fs::path::value_type;
+
+      static size_t Bytes(fs::path const& dir) {
+         return sizeof(fs::path) + dir.native().size() * sizeof(char_type);
+         }
+
+      void Spill() {
+         if(!spill && !(spill = std::tmpfile())) throw std::runtime_error("can't create temporary file for the traversal");
+         const size_t iCount = dirs.size() / 2u;
+         std::fseek(spill, iSpillEnd, SEEK_SET);
+         for(size_t i = 0u; i < iCount; ++i) {
+            auto const& strDir = dirs[i].native();
+            const std::uint64_t iLength = strDir.size();
+            std::fwrite(&iLength, sizeof(iLength), 1u, spill);
+            std::fwrite(strDir.data(), sizeof(char_type), strDir.size(), spill);
+            iBytes -= Bytes(dirs[i]);
+            }
+         if(std::ferror(spill)) throw std::runtime_error("error while writing temporary file for the traversal");
+         chunks.emplace_back(iSpillEnd, iCount);
+         iSpillEnd = std::ftell(spill);
+         dirs.erase(dirs.begin(), dirs.begin() + iCount);
+         }
+
+      void Reload() {
+         auto [iOffset, iCount] = chunks.back();
+         chunks.pop_back();
+         std::fseek(spill, iOffset, SEEK_SET);
+         std::deque<fs::path> loaded;
+         fs::path::string_type strDir;
+         for(size_t i = 0u; i < iCount; ++i) {
+            std::uint64_t iLength = 0u;
+            if(std::fread(&iLength, sizeof(iLength), 1u, spill) != 1u) throw std::runtime_error("error while reading temporary file for the traversal");
+            strDir.resize(iLength);
+            if(std::fread(strDir.data(), sizeof(char_type), iLength, spill) != iLength) throw std::runtime_error("error while reading temporary file for the traversal");
+            iBytes += sizeof(fs::path) + iLength * sizeof(char_type);
+            loaded.emplace_back(strDir);
+            }
+         iSpillEnd = iOffset;
+         dirs = std::move(loaded);
+         }
+
+      size_t                                 iBudget;
+      size_t                                 iBytes    = 0u;
+      std::deque<fs::path>                   dirs;
+      std::FILE*                             spill     = nullptr;
+      long                                   iSpillEnd = 0;
+      std::vector<std::pair<long, size_t>>   chunks;      // offset and count in the file, last on top
+   };
+
+
+// parallel traversal, pool of workers with own stacks, idle workers steal
+// directories from the front of the stacks of the other workers. Workers which
+// find nothing wait for a new directory or the end of the walk. The budget for
+// the pending directories is shared by the stacks, the rest goes to temporary files
+
+template <typename data_type, typename visit_func>
+void Parallel_Walk(fs::path const& root, std::vector<data_type>& data, visit_func visit) {
+   struct TWorkQueue {
+      TWorkQueue(size_t iBudget) : dirs(iBudget) { }
+      std::mutex mtx;
+      TDirStack  dirs;
+      };
+
+   const size_t iWorkers = data.size();
+   std::deque<TWorkQueue> queues;
+   for(size_t i = 0u; i < iWorkers; ++i) queues.emplace_back(std::max<size_t>(iTraversalMemory / iWorkers, 4096u));
+   std::atomic<size_t> pending { 1u };      // directories queued or in work
+   std::atomic<long>   queued  { 1u };      // directories in the deques, shortly negative between pop and push
+   std::atomic<bool>   boAbort { false };
+   std::exception_ptr  error;
+   std::mutex          mtxError;
+   std::mutex          mtxIdle;
+   std::condition_variable idle;
+   queues[0].dirs.Push(root);
+
+   auto fail = [&]() {
+                  {
+                  std::lock_guard<std::mutex> lock(mtxError);
+                  if(!error) error = std::current_exception();
+                  }
+                  { std::lock_guard<std::mutex> lock(mtxIdle); boAbort = true; }
+                  idle.notify_all();
+                  };
+
+   auto worker = [&](size_t id) {
+      auto push = [&](fs::path const& p) {
+                     ++pending;
+                     {
+                     std::lock_guard<std::mutex> lock(queues[id].mtx);
+                     queues[id].dirs.Push(p);
+                     }
+                     { std::lock_guard<std::mutex> lock(mtxIdle); ++queued; }
+                     idle.notify_one();
+                     };
+
+      auto pop = [&](fs::path& p) {
+                     for(size_t i = 0u; i < iWorkers; ++i) {
+                        auto& queue = queues[(id + i) % iWorkers];
+                        std::lock_guard<std::mutex> lock(queue.mtx);
+                        if(!queue.dirs.Empty()) {
+                           p = i == 0u ? queue.dirs.Pop() : queue.dirs.Pop_Front();
+                           return true;
+                           }
+                        }
+                     return false;
+                     };
+
+      for(;;) {
+         fs::path dir;
+         bool boFound = false;
+         try {
+            boFound = pop(dir);
+            }
+         catch(...) {
+            fail();    // the directories of a lost temporary file never end, pending stays above 0
+            }
+         if(!boFound) {
+            std::unique_lock<std::mutex> lock(mtxIdle);
+            if(pending == 0u || boAbort) break;
+            idle.wait(lock, [&]() { return pending == 0u || queued > 0 || boAbort; });
+            continue;
+            }
+         --queued;
+         if(!boAbort) {
+            try {
+               visit(dir, data[id], push);
+               }
+            catch(...) {
+               fail();
+               }
+            }
+         if(--pending == 0u) {
+            { std::lock_guard<std::mutex> lock(mtxIdle); }
+            idle.notify_all();
+            }
+         }
+      };
+
+   std::vector<std::thread> threads;
+   for(size_t i = 1u; i < iWorkers; ++i) threads.emplace_back(worker, i);
+   worker(0u);
+   std::for_each(threads.begin(), threads.end(), [](auto& thread) { thread.join(); });
+   if(error) std::rethrow_exception(error);
+   }
+
+
+void Count_Serial(fs::path const& root, bool boWithSub, TScanFilter const& filter, Dir_Stats_Type& ret) {
+   TDirStack stack(iTraversalMemory);
+   stack.Push(fs::path(root));
+   while(!stack.Empty()) {
+      const fs::path dir = stack.Pop();
+      const auto before = ret;
+      const auto rel_dir = filter.Relative(dir);
+      Read_Directory(dir, [&](auto const& entry) {
+               const bool boDirectory = entry.is_directory();
+               if(filter.Excluded(rel_dir, entry.filename(), boDirectory)) return;
+               if(boDirectory) {
+                  ++ret;
+                  if(boWithSub && !filter.Hidden(entry.filename())) stack.Push(entry.path());
+                  }
+               else ret += entry.file_size();
+               }, true);
+      Add_Progress(before, ret);
+      }
+   }
+
+Dir_Stats_Type Count_Parallel(fs::path const& dir, TScanFilter const& filter) {
+   std::vector<Dir_Stats_Type> partials(iTraversalThreads, Dir_Stats_Type { 0ul, 0ul, 0ull });
+   Parallel_Walk(dir, partials, [&filter](fs::path const& current, Dir_Stats_Type& stats, auto push) {
+            const auto before = stats;
+            const auto rel_dir = filter.Relative(current);
+            Read_Directory(current, [&](auto const& entry) {
+                     const bool boDirectory = entry.is_directory();
+                     if(filter.Excluded(rel_dir, entry.filename(), boDirectory)) return;
+                     if(boDirectory) {
+                        ++stats;
+                        if(!filter.Hidden(entry.filename())) push(entry.path());
+                        }
+                     else stats += entry.file_size();
+                     }, true);
+            Add_Progress(before, stats);
+            });
+   auto ret = Dir_Stats_Type { 0ul, 0ul, 0ull  };
+   std::for_each(partials.begin(), partials.end(), [&ret](auto const& val) { ret += val; });
+   return ret;
+   }
+
+
+/// only matching files get a full path, directories only for the recursion; nullptr matches all files
+template <typename entry_type>
+bool Is_Matching(entry_type const& entry, std::set<std::string> const* extensions) {
+   return !extensions || extensions->find(std::string(Extension_Of(entry.filename()))) != extensions->end();
+   }
+
+/// collects found files and hands them over to the sink in batches
+class TFindBatch {
+   public:
+      TFindBatch(Find_Sink_Type const& s, size_t size) : sink(s), iBatchSize(std::max<size_t>(1u, size)) {
+         files.reserve(iBatchSize);
+         }
+
+      void Add(fs::path file) {
+         files.emplace_back(std::move(file));
+         if(files.size() >= iBatchSize) Flush();
+         }
+
+      void Flush() {
+         if(files.empty()) return;
+         iCount += files.size();
+         sink(std::move(files));
+         files.clear();
+         files.reserve(iBatchSize);
+         }
+
+      size_t Count() const { return iCount + files.size(); }
+
+   private:
+      Find_Sink_Type const& sink;
+      size_t                iBatchSize;
+      size_t                iCount = 0u;
+      std::vector<fs::path> files;
+   };
+
+
+void Find_Serial(TFindBatch& batch, fs::path const& root, std::set<std::string> const* extensions, bool boWithSub,
+                 TScanFilter const& filter) {
+   TDirStack stack(iTraversalMemory);
+   stack.Push(fs::path(root));
+   std::vector<fs::path> subdirs;
+   while(!stack.Empty()) {
+      const fs::path dir = stack.Pop();
+      subdirs.clear();
+      const size_t iFound = batch.Count();
+      const auto rel_dir = filter.Relative(dir);
+      try {
+         Read_Directory(dir, [&](auto const& entry) {
+                  if(entry.is_directory()) {
+                     if(boWithSub && !filter.Hidden(entry.filename()) && !filter.Excluded(rel_dir, entry.filename(), true))
+                        subdirs.emplace_back(entry.path());
+                     }
+                  else if(Is_Matching(entry, extensions) && !filter.Excluded(rel_dir, entry.filename(), false))
+                     batch.Add(entry.path());
+                  });
+         Scan_Control().Add_Files(batch.Count() - iFound);
+         }
+      catch(TScanCancelled const&) {
+         throw;
+         }
+      catch(std::exception& ex) {
+         std::cerr << "error: " << ex.what() << std::endl;
+         }
+      // reverse, so the directories are processed in the order they were read
+      std::for_each(subdirs.rbegin(), subdirs.rend(), [&stack](auto& subdir) { stack.Push(std::move(subdir)); });
+      }
+   }
+
+
+/**
+  \brief handover of found files and errors from the workers to the calling thread
+  \details at most iMaxBatches batches wait, a worker waits in Push() until the calling
+           thread has taken them, so the found files aren't kept when the sink is slower
+           than the walk. A cancelled scan ends the wait with TScanCancelled, after
+           Abandon() Push() ends the walk the same way.
+*/
+class TFindChannel {
+   public:
+      static constexpr size_t iMaxBatches = 4u;
+
+      void Push(std::vector<fs::path>&& files) {
+         {
+         std::unique_lock<std::mutex> lock(mtx);
+         while(!boAbandoned && batches.size() >= iMaxBatches) {
+            if(Scan_Control().Cancelled()) throw TScanCancelled();
+            space.wait_for(lock, std::chrono::milliseconds(50));
+            }
+         if(boAbandoned) throw TScanCancelled();   // ends the walk, the error of the calling thread counts
+         batches.emplace_back(std::move(files));
+         }
+         cv.notify_one();
+         }
+
+      void Error(std::string&& strError) {
+         { std::lock_guard<std::mutex> lock(mtx); errors.emplace_back(std::move(strError)); }
+         cv.notify_one();
+         }
+
+      void Close() {
+         { std::lock_guard<std::mutex> lock(mtx); boClosed = true; }
+         cv.notify_one();
+         }
+
+      /// the calling thread takes nothing more, waiting and following workers drop their batches
+      void Abandon() {
+         { std::lock_guard<std::mutex> lock(mtx); boAbandoned = true; batches.clear(); }
+         space.notify_all();
+         }
+
+      /// wait for new data, false when the channel is closed and drained
+      bool Wait(std::vector<std::vector<fs::path>>& new_batches, std::vector<std::string>& new_errors) {
+         {
+         std::unique_lock<std::mutex> lock(mtx);
+         cv.wait(lock, [this]() { return boClosed || !batches.empty() || !errors.empty(); });
+         if(batches.empty() && errors.empty()) return false;
+         std::swap(new_batches, batches);
+         std::swap(new_errors, errors);
+         }
+         space.notify_all();
+         return true;
+         }
+
+   private:
+      std::mutex                         mtx;
+      std::condition_variable            cv;
+      std::condition_variable            space;      ///< for the workers waiting in Push()
+      std::vector<std::vector<fs::path>> batches;
+      std::vector<std::string>           errors;
+      bool                               boClosed    = false;
+      bool                               boAbandoned = false;
+   };
+
+
+void Find_Parallel(TFindBatch& batch, fs::path const& dir, std::set<std::string> const* extensions, size_t iBatchSize,
+                   TScanFilter const& filter) {
+   std::vector<std::vector<fs::path>> partials(iTraversalThreads);
+   TFindChannel channel;
+   std::exception_ptr error;
+
+   std::thread walker([&]() {
+      try {
+         Parallel_Walk(dir, partials, [&](fs::path const& current, std::vector<fs::path>& files, auto push) {
+                  size_t iFound = 0u;
+                  const auto rel_dir = filter.Relative(current);
+                  try {
+                     Read_Directory(current, [&](auto const& entry) {
+                              if(entry.is_directory()) {
+                                 if(!filter.Hidden(entry.filename()) && !filter.Excluded(rel_dir, entry.filename(), true))
+                                    push(entry.path());
+                                 }
+                              else if(Is_Matching(entry, extensions) && !filter.Excluded(rel_dir, entry.filename(), false)) {
+                                 ++iFound;
+                                 files.emplace_back(entry.path());
+                                 if(files.size() >= iBatchSize) channel.Push(std::exchange(files, { }));
+                                 }
+                              });
+                     Scan_Control().Add_Files(iFound);
+                     }
+                  catch(TScanCancelled const&) {
+                     throw;
+                     }
+                  catch(std::exception& ex) {
+                     channel.Error(ex.what());
+                     }
+                  if(!files.empty()) channel.Push(std::exchange(files, { }));
+                  });
+         }
+      catch(...) {
+         error = std::current_exception();
+         }
+      channel.Close();
+      });
+
+   // the sink and the streams are connected with the gui, call them only from the calling thread
+   std::vector<std::vector<fs::path>> batches;
+   std::vector<std::string> errors;
+   try {
+      while(channel.Wait(batches, errors)) {
+         for(auto const& strError : errors) std::cerr << "error: " << strError << std::endl;
+         for(auto& files : batches) {
+            for(auto& file : files) batch.Add(std::move(file));
+            }
+         batch.Flush();
+         batches.clear();
+         errors.clear();
+         }
+      }
+   catch(...) {
+      // a failing sink, the workers mustn't wait for it
+      channel.Abandon();
+      walker.join();
+      throw;
+      }
+   walker.join();
+   if(error) std::rethrow_exception(error);
+   }
+
+} // end of anonymous namespace
+
+
+void Set_Traversal_Threads(unsigned iThreads) {
+   iTraversalThreads = std::max(1u, iThreads);
+   }
+
+unsigned Get_Traversal_Threads() {
+   return iTraversalThreads;
+   }
+
+/// budget for the pending directories of the serial and the parallel traversal, the rest is moved
+/// to a temporary file. Count_Snapshot() isn't bounded by it, it holds the tree of the snapshot in memory
+void Set_Traversal_Memory(size_t iBytes) {
+   iTraversalMemory = std::max<size_t>(iBytes, 4096u);
+   }
+
+/// the native backend is only available on linux, otherwise std::filesystem is used
+void Set_Traversal_Backend(ETraversalBackend eBackend) {
+#if defined(__linux__)
+   eTraversalBackend = eBackend;
+#else
+   eTraversalBackend = ETraversalBackend::filesystem;
+#endif
+   }
+
+ETraversalBackend Get_Traversal_Backend() {
+   return eTraversalBackend;
+   }
+
+
+Dir_Stats_Type Count(fs::path const& dir, bool boWithSub) {
+   auto ret = Dir_Stats_Type { 0ul, 0ul, 0ull  };
+   if(Is_Hidden(dir)) return ret;
+   TScanFilter filter(dir);
+   if(boWithSub && iTraversalThreads > 1u) return Count_Parallel(dir, filter);
+   Count_Serial(dir, boWithSub, filter, ret);
+   return ret;
+   }
+
+
+namespace {
+
+/// entry of one of the backends for Read_Entries()
+template <typename entry_type>
+class TDirEntryOf : public TDirEntry {
+   public:
+      TDirEntryOf(entry_type const& e) : entry(e) { }
+      std::string_view filename() const override { return entry.filename(); }
+      bool             is_directory() const override { return entry.is_directory(); }
+      std::uintmax_t   file_size() const override { return entry.file_size(); }
+
+   private:
+      entry_type const& entry;
+   };
+
+} // end of anonymous namespace
+
+/// Read_Directory() for the snapshot and the live mode, all entries get their sizes in one batch
+void Read_Entries(fs::path const& dir, Dir_Entry_Func const& func) {
+   Read_Directory(dir, [&func](auto const& entry) {
+            func(TDirEntryOf<std::decay_t<decltype(entry)>>(entry));
+            }, true);
+   }
+
+
+namespace {
+
+/// files with one of the extensions, all files for nullptr
+size_t Find_Files(fs::path const& dir, std::set<std::string> const* extensions, Find_Sink_Type const& sink,
+                  bool boWithSub, size_t iBatchSize) {
+   if(Is_Hidden(dir)) return 0u;
+   TFindBatch batch(sink, iBatchSize);
+   TScanFilter filter(dir);
+   if(boWithSub && iTraversalThreads > 1u) Find_Parallel(batch, dir, extensions, iBatchSize, filter);
+   else Find_Serial(batch, dir, extensions, boWithSub, filter);
+   batch.Flush();
+   return batch.Count();
+   }
+
+size_t Collect_Files(std::vector<fs::path>& ret, fs::path const& dir, std::set<std::string> const* extensions, bool boWithSub) {
+   const auto start = ret.size();
+   Find_Files(dir, extensions, [&ret](std::vector<fs::path>&& files) {
+                     std::move(files.begin(), files.end(), std::back_inserter(ret));
+                     }, boWithSub, 256u);
+   // same order for every count of threads, the serial walk has the order of the directories
+   if(boWithSub) std::sort(ret.begin() + start, ret.end());
+   return ret.size();
+   }
+
+} // end of anonymous namespace
+
+
+size_t Find_Stream(fs::path const& dir, std::set<std::string> const& extensions, Find_Sink_Type const& sink,
+                   bool boWithSub, size_t iBatchSize) {
+   return Find_Files(dir, &extensions, sink, boWithSub, iBatchSize);
+   }
+
+
+/// files with one of the extensions, an empty set finds nothing
+size_t Find(std::vector<fs::path>& ret, fs::path const& dir, std::set<std::string> const& extensions, bool boWithSub) {
+   return Collect_Files(ret, dir, &extensions, boWithSub);
+   }
+
+/// all files, whatever their extension, e.g. for the search of duplicates
+size_t Find_All(std::vector<fs::path>& ret, fs::path const& dir, bool boWithSub) {
+   return Collect_Files(ret, dir, nullptr, boWithSub);
+   }
+
+
+/// switch between the batched metadata stage (pool of threads) and single synchronous calls
+void Set_Batched_Metadata(bool boBatched) {
+   boBatchedMetadata = boBatched;
+   }
+
+/// status of all files with the metadata stage, errors are in the result, not thrown
+std::vector<TFileStatus> Stat_Files(std::vector<fs::path> const& files) {
+   std::vector<TFileStatus> ret(files.size());
+#if defined(__linux__)
+   std::vector<char const*> names;
+   names.reserve(files.size());
+   for(auto const& file : files) names.emplace_back(file.c_str());
+   Stat_Batch(AT_FDCWD, names, ret);
+#else
+   if(boBatchedMetadata) TStatPool::Instance().For_Each(files.size(), [&](size_t i) { Stat_One(files[i], ret[i]); });
+   else for(size_t i = 0u; i < files.size(); ++i) Stat_One(files[i], ret[i]);
+#endif
+   return ret;
+   }
+
+//----------------------------------------------------------------------------
+// subtotals of all directories with one walk. The array of nodes is the queue
+// of a breadth first walk, the directories of one level are read in parallel
+// and their children are appended in the order of the parents, so the tree is
+// the same for every count of threads. Only the paths of the current level are
+// kept, the largest files are collected in bounded heaps.
+namespace {
+
+const size_t iMinParallelLevel = 64u;   ///< smaller levels are read without additional threads
+
+/// the iCount largest files, heap with the smallest of them on top
+class TTopFiles {
+   public:
+      struct TFile {
+         std::uintmax_t iSize;
+         size_t         iDir;
+         std::string    strName;
+
+         /// larger first, equal sizes in the order of the tree
+         bool operator > (TFile const& other) const {
+            return std::tie(iSize, other.iDir, other.strName) > std::tie(other.iSize, iDir, strName);
+            }
+         };
+
+      TTopFiles(size_t count) : iCount(count) { }
+
+      void Add(std::uintmax_t iSize, size_t iDir, std::string_view name) {
+         if(iCount == 0u) return;
+         if(files.size() == iCount && iSize < files.front().iSize) return;
+         TFile file { iSize, iDir, std::string(name) };
+         if(files.size() == iCount) {
+            if(!(file > files.front())) return;
+            std::pop_heap(files.begin(), files.end(), std::greater<TFile>());
+            files.back() = std::move(file);
+            }
+         else files.emplace_back(std::move(file));
+         std::push_heap(files.begin(), files.end(), std::greater<TFile>());
+         }
+
+      void Merge(TTopFiles const& other) {
+         for(auto const& file : other.files) Add(file.iSize, file.iDir, file.strName);
+         }
+
+      /// largest first
+      std::vector<TFile> Sorted() const {
+         auto ret = files;
+         std::sort_heap(ret.begin(), ret.end(), std::greater<TFile>());
+         return ret;
+         }
+
+   private:
+      size_t             iCount;
+      std::vector<TFile> files;
+   };
+
+/// values of one directory of the current level and the names of the subdirectories to read
+struct TLevelEntry {
+   std::uint32_t iFiles    = 0u;
+   std::uint32_t iDirs     = 0u;
+   std::uint64_t iSize     = 0u;
+   std::uint32_t iChildren = 0u;
+   std::string   children;            // '\0' separated
+   };
+
+void Read_Tree_Dir(fs::path const& dir, size_t idx, TScanFilter const& filter, TLevelEntry& ret, TTopFiles& top) {
+   const auto rel_dir = filter.Relative(dir);
+   Read_Directory(dir, [&](auto const& entry) {
+            const bool boDirectory = entry.is_directory();
+            if(filter.Excluded(rel_dir, entry.filename(), boDirectory)) return;
+            if(boDirectory) {
+               ++ret.iDirs;
+               if(!filter.Hidden(entry.filename())) {
+                  ret.children.append(entry.filename());
+                  ret.children.push_back('\0');
+                  ++ret.iChildren;
+                  }
+               }
+            else {
+               const auto iSize = entry.file_size();
+               ++ret.iFiles;
+               ret.iSize += iSize;
+               top.Add(iSize, idx, entry.filename());
+               }
+            }, true);
+   Scan_Control().Add_Files(ret.iFiles, ret.iSize);
+   }
+
+/// read all directories of a level, directories are taken by the workers from a shared counter
+void Read_Tree_Level(std::vector<fs::path> const& paths, size_t iBegin, TScanFilter const& filter,
+                     std::vector<TLevelEntry>& level, std::vector<TTopFiles>& tops) {
+   std::atomic<size_t> next { 0u };
+   std::exception_ptr  error;
+   std::mutex          mtxError;
+   auto worker = [&](size_t id) {
+      for(size_t i; (i = next++) < paths.size(); ) {
+         try {
+            Read_Tree_Dir(paths[i], iBegin + i, filter, level[i], tops[id]);
+            }
+         catch(...) {
+            std::lock_guard<std::mutex> lock(mtxError);
+            if(!error) error = std::current_exception();
+            next = paths.size();
+            }
+         }
+      };
+
+   const size_t iWorkers = paths.size() < iMinParallelLevel ? 1u : std::min(tops.size(), paths.size() / 16u);
+   std::vector<std::thread> threads;
+   for(size_t i = 1u; i < iWorkers; ++i) threads.emplace_back(worker, i);
+   worker(0u);
+   std::for_each(threads.begin(), threads.end(), [](auto& thread) { thread.join(); });
+   if(error) std::rethrow_exception(error);
+   }
+
+template <typename ty>
+std::uint32_t Tree_Index(ty val) {
+   if(val > std::numeric_limits<std::uint32_t>::max()) throw std::runtime_error("directory tree too large for Count_Tree");
+   return static_cast<std::uint32_t>(val);
+   }
+
+} // end of anonymous namespace
+
+
+fs::path TDirTree::Path(size_t idx) const {
+   std::vector<size_t> chain;
+   for(; idx != 0u; idx = nodes[idx].iParent) chain.emplace_back(idx);
+   fs::path ret = root;
+   for(auto it = chain.rbegin(); it != chain.rend(); ++it) ret /= fs::path(names.data() + nodes[*it].iName);
+   return ret;
+   }
+
+size_t TDirTree::Parent(size_t idx) const {
+   return idx == 0u ? npos : nodes[idx].iParent;
+   }
+
+Dir_Stats_Type TDirTree::Own(size_t idx) const {
+   auto const& node = nodes[idx];
+   return Dir_Stats_Type { node.iOwnFiles, node.iOwnDirs, node.iOwnSize };
+   }
+
+Dir_Stats_Type TDirTree::Total(size_t idx) const {
+   auto const& node = nodes[idx];
+   return Dir_Stats_Type { node.iFiles, node.iDirs, node.iSize };
+   }
+
+/// the iCount largest subtrees without the root, largest first, with a bounded heap
+std::vector<size_t> TDirTree::Top_Directories(size_t iCount) const {
+   auto larger = [this](size_t lhs, size_t rhs) {
+          return nodes[lhs].iSize != nodes[rhs].iSize ? nodes[lhs].iSize > nodes[rhs].iSize : lhs < rhs;
+          };
+   std::vector<size_t> heap;
+   if(iCount == 0u) return heap;
+   for(size_t idx = 1u; idx < nodes.size(); ++idx) {
+      if(heap.size() < iCount) {
+         heap.emplace_back(idx);
+         std::push_heap(heap.begin(), heap.end(), larger);
+         }
+      else if(larger(idx, heap.front())) {
+         std::pop_heap(heap.begin(), heap.end(), larger);
+         heap.back() = idx;
+         std::push_heap(heap.begin(), heap.end(), larger);
+         }
+      }
+   std::sort_heap(heap.begin(), heap.end(), larger);
+   return heap;
+   }
+
+
+/**
+  \brief count like Count(dir, true) and keep the subtotals of every directory
+  \param dir [IN] root of the tree
+  \param tree [OUT] subtotals, node 0 is the root
+  \param iTopFiles [IN] count of the largest files to keep in tree.Top_Files()
+  \return totals of the tree, same as tree.Total(0)
+*/
+Dir_Stats_Type Count_Tree(fs::path const& dir, TDirTree& tree, size_t iTopFiles) {
+   tree.root = dir;
+   tree.nodes.assign(1u, TDirTree::TNode { });
+   tree.names.assign(1u, '\0');
+   tree.top_files.clear();
+   if(Is_Hidden(dir)) return tree.Total(0u);
+
+   TScanFilter filter(dir);
+   std::vector<TTopFiles> tops(iTraversalThreads, TTopFiles(iTopFiles));
+   std::vector<fs::path> paths { dir };
+   for(size_t iBegin = 0u; !paths.empty(); ) {
+      std::vector<TLevelEntry> level(paths.size());
+      Read_Tree_Level(paths, iBegin, filter, level, tops);
+
+      std::vector<fs::path> next_paths;
+      for(size_t i = 0u; i < level.size(); ++i) {
+         auto& entry = level[i];
+         auto& node = tree.nodes[iBegin + i];
+         node.iOwnFiles   = entry.iFiles;
+         node.iOwnDirs    = entry.iDirs;
+         node.iOwnSize    = entry.iSize;
+         node.iFirstChild = Tree_Index(tree.nodes.size());
+         node.iChildren   = entry.iChildren;
+         for(size_t pos = 0u; pos < entry.children.size(); ) {
+            std::string_view name(entry.children.data() + pos);
+            TDirTree::TNode child;
+            child.iParent = Tree_Index(iBegin + i);
+            child.iName   = Tree_Index(tree.names.size());
+            tree.names.append(name);
+            tree.names.push_back('\0');
+            tree.nodes.emplace_back(child);
+            next_paths.emplace_back(paths[i] / fs::path(name));
+            pos += name.size() + 1u;
+            }
+         std::string().swap(entry.children);
+         }
+      iBegin += paths.size();
+      paths = std::move(next_paths);
+      }
+
+   // children follow their parents, so the totals are complete in reverse order
+   for(size_t idx = tree.nodes.size(); idx-- > 0u; ) {
+      auto& node = tree.nodes[idx];
+      node.iFiles += node.iOwnFiles;
+      node.iDirs  += node.iOwnDirs;
+      node.iSize  += node.iOwnSize;
+      if(idx > 0u) {
+         auto& parent = tree.nodes[node.iParent];
+         parent.iFiles += node.iFiles;
+         parent.iDirs  += node.iDirs;
+         parent.iSize  += node.iSize;
+         }
+      }
+
+   for(size_t i = 1u; i < tops.size(); ++i) tops[0].Merge(tops[i]);
+   for(auto const& file : tops[0].Sorted())
+      tree.top_files.emplace_back(tree.Path(file.iDir) / fs::path(file.strName), file.iSize);
+   return tree.Total(0u);
+   }
@@ -0,0 +1,319 @@
+//---------------------------------------------------------------------------
+
+#pragma hdrstop
+
+#include "FileUtil.h"
+#include "FileUtilInternal.h"
+
+#include <set>
+#include <unordered_map>
+#include <chrono>
+
+#if defined(__linux__)
+   #include <unistd.h>
+   #include <sys/inotify.h>
+   #include <poll.h>
+#endif
+//---------------------------------------------------------------------------
+
+
+//----------------------------------------------------------------------------
+// live mode for Count, tree of all directories with the values of the direct
+// entries and the totals of the subtree. A change in a directory rereads only
+// this directory, the difference is added to the directory and its parents.
+// Directories without watch (limit of inotify reached, other systems) are
+// read again periodically.
+namespace {
+
+const size_t iNoNode = static_cast<size_t>(-1);
+
+} // end of anonymous namespace
+
+struct TCountWatcher::TImpl {
+   struct TWatchNode {
+      fs::path                                path;
+      size_t                                  iParent = iNoNode;
+      int                                     iWatch  = -1;
+      bool                                    boAlive = false;
+      Dir_Stats_Type                          own     { 0ul, 0ul, 0ull };
+      Dir_Stats_Type                          total   { 0ul, 0ul, 0ull };
+      std::unordered_map<std::string, size_t> children;
+      };
+
+   int                                iNotify = -1;
+   std::vector<TWatchNode>            nodes;
+   std::vector<size_t>                free_nodes;
+   std::unordered_map<int, size_t>    watches;
+   std::set<size_t>                   unwatched;
+   std::chrono::steady_clock::time_point last_rescan;
+   std::unique_ptr<TScanFilter>       filter;
+
+   TImpl() {
+   #if defined(__linux__)
+      iNotify = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+   #endif
+      }
+
+   ~TImpl() {
+      Clear();
+   #if defined(__linux__)
+      if(iNotify >= 0) ::close(iNotify);
+   #endif
+      }
+
+   void Clear() {
+   #if defined(__linux__)
+      for(auto const& [wd, idx] : watches) ::inotify_rm_watch(iNotify, wd);
+   #endif
+      nodes.clear();
+      free_nodes.clear();
+      watches.clear();
+      unwatched.clear();
+      }
+
+   /// new values after the change, modulo arithmetic of the unsigned parts gives the right result
+   static void Replace(Dir_Stats_Type& total, Dir_Stats_Type const& before, Dir_Stats_Type const& after) {
+      std::get<0>(total) = std::get<0>(total) - std::get<0>(before) + std::get<0>(after);
+      std::get<1>(total) = std::get<1>(total) - std::get<1>(before) + std::get<1>(after);
+      std::get<2>(total) = std::get<2>(total) - std::get<2>(before) + std::get<2>(after);
+      }
+
+   void Propagate(size_t idx, Dir_Stats_Type const& before, Dir_Stats_Type const& after) {
+      for(size_t parent = nodes[idx].iParent; parent != iNoNode; parent = nodes[parent].iParent)
+         Replace(nodes[parent].total, before, after);
+      }
+
+   size_t New_Node(fs::path const& path, size_t iParent) {
+      size_t idx;
+      if(!free_nodes.empty()) { idx = free_nodes.back(); free_nodes.pop_back(); }
+      else { idx = nodes.size(); nodes.emplace_back(); }
+      auto& node = nodes[idx];
+      node.path    = path;
+      node.iParent = iParent;
+      node.boAlive = true;
+      node.own     = node.total = Dir_Stats_Type { 0ul, 0ul, 0ull };
+      node.children.clear();
+      Add_Watch(idx);
+      return idx;
+      }
+
+   void Add_Watch(size_t idx) {
+      auto& node = nodes[idx];
+   #if defined(__linux__)
+      if(iNotify >= 0) {
+         constexpr auto mask = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MODIFY |
+                               IN_CLOSE_WRITE | IN_ATTRIB | IN_ONLYDIR | IN_DONT_FOLLOW;
+         node.iWatch = ::inotify_add_watch(iNotify, node.path.c_str(), mask);
+         if(node.iWatch >= 0) {
+            // the kernel returns the same descriptor for the same inode, the older node
+            // (a hard link or a stale entry of a moved directory) is read again without watch
+            if(auto it = watches.find(node.iWatch); it != watches.end() && it->second != idx) {
+               nodes[it->second].iWatch = -1;
+               unwatched.insert(it->second);
+               }
+            watches[node.iWatch] = idx;
+            unwatched.erase(idx);
+            return;
+            }
+         }
+   #endif
+      node.iWatch = -1;
+      unwatched.insert(idx);   // ENOSPC (max_user_watches) or no inotify
+      }
+
+   void Remove_Subtree(size_t root) {
+      std::vector<size_t> stack { root };
+      while(!stack.empty()) {
+         const size_t idx = stack.back();
+         stack.pop_back();
+         auto& node = nodes[idx];
+         for(auto const& [name, child] : node.children) stack.emplace_back(child);
+         if(node.iWatch >= 0) {
+   #if defined(__linux__)
+            ::inotify_rm_watch(iNotify, node.iWatch);
+   #endif
+            watches.erase(node.iWatch);
+            }
+         unwatched.erase(idx);
+         node.children.clear();
+         node.iWatch  = -1;
+         node.boAlive = false;
+         free_nodes.emplace_back(idx);
+         }
+      }
+
+   /// read the direct entries of a directory, a vanished directory or file counts as empty
+   void Scan(fs::path const& dir, Dir_Stats_Type& own, std::set<std::string>& subdirs) {
+      own = Dir_Stats_Type { 0ul, 0ul, 0ull };
+      try {
+         const auto rel_dir = filter->Relative(dir);
+         Read_Entries(dir, [this, &rel_dir, &own, &subdirs](auto const& entry) {
+                  const bool boDirectory = entry.is_directory();
+                  if(filter->Excluded(rel_dir, entry.filename(), boDirectory)) return;
+                  if(boDirectory) {
+                     ++own;
+                     if(!filter->Hidden(entry.filename())) subdirs.emplace(entry.filename());
+                     }
+                  else {
+                     try { own += entry.file_size(); }
+                     catch(fs::filesystem_error const&) { }
+                     }
+                  });
+         Scan_Control().Add_Files(std::get<0>(own), std::get<2>(own));
+         }
+      catch(fs::filesystem_error const&) {
+         own = Dir_Stats_Type { 0ul, 0ul, 0ull };
+         subdirs.clear();
+         }
+      }
+
+   /// build the node and the complete subtree, the totals are in the new node
+   size_t Add_Subtree(fs::path const& path, size_t iParent) {
+      const size_t root = New_Node(path, iParent);
+      std::vector<size_t> created;                     // parents before children
+      std::vector<size_t> stack { root };
+      std::set<std::string> subdirs;
+      while(!stack.empty()) {
+         const size_t idx = stack.back();
+         stack.pop_back();
+         created.emplace_back(idx);
+         subdirs.clear();
+         Dir_Stats_Type own;
+         Scan(nodes[idx].path, own, subdirs);
+         nodes[idx].own = nodes[idx].total = own;
+         for(auto const& name : subdirs) {
+            const size_t child = New_Node(nodes[idx].path / name, idx);
+            nodes[idx].children.emplace(name, child);
+            stack.emplace_back(child);
+            }
+         }
+      // totals from the leaves up to the root of the subtree
+      for(auto it = created.rbegin(); it != created.rend() && *it != root; ++it)
+         nodes[nodes[*it].iParent].total += nodes[*it].total;
+      return root;
+      }
+
+   /// read a directory again and correct the values of the directory and all parents
+   void Refresh(size_t idx) {
+      if(idx >= nodes.size() || !nodes[idx].boAlive) return;
+      const auto before = nodes[idx].total;
+      std::set<std::string> subdirs;
+      Dir_Stats_Type own;
+      Scan(nodes[idx].path, own, subdirs);
+
+      Dir_Stats_Type total = own;
+      std::vector<std::string> removed;
+      for(auto const& [name, child] : nodes[idx].children) {
+         if(subdirs.find(name) == subdirs.end()) removed.emplace_back(name);
+         }
+      for(auto const& name : removed) {
+         Remove_Subtree(nodes[idx].children[name]);
+         nodes[idx].children.erase(name);
+         }
+      for(auto const& name : subdirs) {
+         if(auto it = nodes[idx].children.find(name); it != nodes[idx].children.end()) {
+            total += nodes[it->second].total;
+            }
+         else {
+            const size_t child = Add_Subtree(nodes[idx].path / name, idx);
+            total += nodes[child].total;
+            nodes[idx].children.emplace(name, child);
+            }
+         }
+      nodes[idx].own   = own;
+      nodes[idx].total = total;
+      Propagate(idx, before, total);
+      }
+
+   /// read all pending events, the affected directories are read once
+   bool Read_Events(std::set<size_t>& dirty) {
+   #if defined(__linux__)
+      if(iNotify < 0) return false;
+      alignas(struct inotify_event) char buffer[64 * 1024];
+      bool boOverflow = false;
+      for(;;) {
+         auto iRead = ::read(iNotify, buffer, sizeof(buffer));
+         if(iRead <= 0) break;   // EAGAIN, nothing more pending
+         for(long pos = 0; pos < iRead; ) {
+            auto const* event = reinterpret_cast<struct inotify_event const*>(buffer + pos);
+            pos += sizeof(struct inotify_event) + event->len;
+            if(event->mask & IN_Q_OVERFLOW) boOverflow = true;
+            else if(auto it = watches.find(event->wd); it != watches.end()) {
+               // the watch is gone (directory removed, moved away or unmounted), the node
+               // is read now and watched again with the periodic rescan of unwatched nodes
+               const size_t idx = it->second;
+               if(event->mask & IN_IGNORED) {
+                  nodes[idx].iWatch = -1;
+                  unwatched.insert(idx);
+                  watches.erase(it);
+                  }
+               dirty.insert(idx);
+               }
+            }
+         }
+      return boOverflow;
+   #else
+      (void)dirty;
+      return false;
+   #endif
+      }
+   };
+
+
+TCountWatcher::TCountWatcher() : impl(std::make_unique<TImpl>()) { }
+
+TCountWatcher::~TCountWatcher() = default;
+
+/// initial count of the directory and registration of the watches
+Dir_Stats_Type TCountWatcher::Start(fs::path const& root) {
+   impl->Clear();
+   impl->last_rescan = std::chrono::steady_clock::now();
+   if(Is_Hidden(root)) return Dir_Stats_Type { 0ul, 0ul, 0ull };
+   impl->filter = std::make_unique<TScanFilter>(root);
+   try {
+      return impl->nodes[impl->Add_Subtree(root, iNoNode)].total;
+      }
+   catch(...) {
+      impl->Clear();            // cancelled, no half built tree
+      throw;
+      }
+   }
+
+void TCountWatcher::Stop() {
+   impl->Clear();
+   }
+
+bool TCountWatcher::Active() const {
+   return !impl->nodes.empty();
+   }
+
+Dir_Stats_Type TCountWatcher::Totals() const {
+   return impl->nodes.empty() ? Dir_Stats_Type { 0ul, 0ul, 0ull } : impl->nodes[0].total;
+   }
+
+size_t TCountWatcher::Unwatched() const {
+   return impl->unwatched.size();
+   }
+
+/** apply all pending changes to the totals, directories without watch are read
+    again when the interval is over. Returns true when the totals changed. */
+bool TCountWatcher::Update(std::chrono::milliseconds rescan_interval) {
+   if(!Active()) return false;
+   const auto before = Totals();
+   std::set<size_t> dirty;
+   if(impl->Read_Events(dirty)) {
+      // lost events, all directories have to be read again
+      for(size_t i = 0u; i < impl->nodes.size(); ++i) if(impl->nodes[i].boAlive) dirty.insert(i);
+      }
+
+   if(auto now = std::chrono::steady_clock::now(); now - impl->last_rescan >= rescan_interval) {
+      impl->last_rescan = now;
+      for(auto idx : std::vector<size_t>(impl->unwatched.begin(), impl->unwatched.end())) {
+         impl->Add_Watch(idx);    // maybe watches are free again
+         dirty.insert(idx);
+         }
+      }
+
+   for(auto idx : dirty) impl->Refresh(idx);
+   return Totals() != before;
+   }
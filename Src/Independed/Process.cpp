@@ -35,11 +35,23 @@
 #include <tuple>
 #include <vector>
 #include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <type_traits>
 #include <iterator>
 #include <algorithm>
+#include <numeric>
+#include <limits>
+#include <sstream>
 #include <functional>
 #include <exception>
 #include <fstream>
+#include <ctime>
+#include <system_error>
+#include <streambuf>
+#include <mutex>
+#include <thread>
+#include <chrono>
 
 
 
@@ -61,10 +73,69 @@ TStreamWrapper<Latin> old_cout(std::cout);
 TStreamWrapper<Latin> old_cerr(std::cerr);
 TStreamWrapper<Latin> old_clog(std::clog);
 
+/**
+  \brief buffer for a stream while an action runs in the background
+  \details the text is collected under a lock and written to the original buffer
+           of the stream (the control of the form) in TProcess::Poll(), so only the
+           gui thread touches the controls. Complete lines only, the rest at the end.
+*/
+class TPostBuffer : public std::streambuf {
+   public:
+      TPostBuffer(std::ostream& s) : stream(s), target(s.rdbuf()) { stream.rdbuf(this); }
+      TPostBuffer(TPostBuffer const&) = delete;
+      ~TPostBuffer() { stream.rdbuf(target); }
+
+      std::streambuf* Target() const { return target; }
+
+      /// pass the collected text to the original buffer, only in the gui thread
+      void Flush(bool boComplete = false) {
+         std::string strText;
+         {
+            std::lock_guard<std::mutex> lock(mtx);
+            size_t pos = boComplete ? text.size() : text.rfind('\n');
+            if(pos == std::string::npos) return;
+            if(!boComplete) ++pos;
+            strText = text.substr(0u, pos);
+            text.erase(0u, pos);
+         }
+         if(!strText.empty()) {
+            target->sputn(strText.data(), static_cast<std::streamsize>(strText.size()));
+            target->pubsync();
+            }
+         }
+
+   protected:
+      int_type overflow(int_type ch) override {
+         if(!traits_type::eq_int_type(ch, traits_type::eof())) {
+            std::lock_guard<std::mutex> lock(mtx);
+            text.push_back(traits_type::to_char_type(ch));
+            }
+         return traits_type::not_eof(ch);
+         }
+
+      std::streamsize xsputn(char_type const* s, std::streamsize n) override {
+         std::lock_guard<std::mutex> lock(mtx);
+         text.append(s, static_cast<size_t>(n));
+         return n;
+         }
+
+   private:
+      std::ostream&   stream;
+      std::streambuf* target;
+      std::mutex      mtx;
+      std::string     text;
+   };
+
+/// interval for the progress in the status bar
+const std::chrono::milliseconds progress_interval { 250 };
+
+
 /// extensions for c++ builder project files
 std::set<std::string> TProcess::project_extensions = { ".cbproj" };
 std::set<std::string> TProcess::header_files = { ".h", ".hxx", ".hpp" };
 std::set<std::string> TProcess::form_files = { ".dfm", ".fmx" };
+/// file with gitignore- style patterns in the scanned directory
+std::string TProcess::exclude_file = ".fileappignore";
 
 
 
@@ -95,7 +166,27 @@ std::vector<tplList<Latin>> TProcess::Count_Columns {
 std::vector<tplList<Latin>> TProcess::File_Columns {
     		  tplList<Latin> { "file",       1310, EMyAlignmentType::left },
               tplList<Latin> { "time",        265, EMyAlignmentType::left },
-              tplList<Latin> { "size",        150, EMyAlignmentType::right } };
+              tplList<Latin> { "size",        150, EMyAlignmentType::right },
+              tplList<Latin> { "content",     150, EMyAlignmentType::right } };
+
+/// vector with captions and params for the largest directories and files
+std::vector<tplList<Latin>> TProcess::Usage_Columns {
+    		  tplList<Latin> { "path",        1010, EMyAlignmentType::left },
+              tplList<Latin> { "files",        200, EMyAlignmentType::right },
+              tplList<Latin> { "directories",  200, EMyAlignmentType::right },
+              tplList<Latin> { "size",         200, EMyAlignmentType::right } };
+
+/// vector with captions and params for the optional wc- style columns of the file and project lists
+std::vector<tplList<Latin>> TProcess::Text_Columns {
+    		  tplList<Latin> { "words",        150, EMyAlignmentType::right },
+              tplList<Latin> { "longest line", 180, EMyAlignmentType::right },
+              tplList<Latin> { "line ends",    250, EMyAlignmentType::left } };
+
+/// vector with captions and params for the groups of files with the same content
+std::vector<tplList<Latin>> TProcess::Duplicates_Columns {
+    		  tplList<Latin> { "file",        1310, EMyAlignmentType::left },
+              tplList<Latin> { "group",        150, EMyAlignmentType::right },
+              tplList<Latin> { "size",         200, EMyAlignmentType::right } };
 
 
 constexpr int iMyData_Project  =  0; ///< constant for position of name of project in tplData
@@ -156,6 +247,18 @@ size_t parse(string_type const& source, std::string const& del, container& list)
 
 
 
+TProcess::TProcess() = default;
+
+/// a running action is cancelled and waited for, the streams get their buffers back
+TProcess::~TProcess() {
+   if(worker.joinable()) {
+      Scan_Control().Cancel();
+      worker.join();
+      }
+   posted.clear();
+   }
+
+
  /**
    \brief Intitialize the main window of the application
    \param form [IN] rvalue to form, which is used as main window
@@ -183,6 +286,10 @@ size_t parse(string_type const& source, std::string const& del, container& list)
    frm.Set<EMyFrameworkType::button>("btnCount", "count");
    frm.Set<EMyFrameworkType::button>("btnShow",  "show");     // !!!
    frm.Set<EMyFrameworkType::button>("btnParse", "parse");
+   frm.Set<EMyFrameworkType::button>("btnSnapshot", "incremental count");
+   frm.Set<EMyFrameworkType::button>("btnRescan",   "full rescan");
+   frm.Set<EMyFrameworkType::button>("btnWatch",    "watch");
+   frm.Set<EMyFrameworkType::button>("btnDuplicates", "duplicates");
 
    std::ostream mys(frm.GetAsStreamBuff<Latin, EMyFrameworkType::listbox>("lbValues"));
    std::vector<std::string> test = { ".cpp", ".h", ".dfm", ".fmx", ".cbproj", ".c", ".hpp" };
@@ -195,8 +302,7 @@ size_t parse(string_type const& source, std::string const& del, container& list)
 
 void TProcess::ShowAction() {
    try {
-      TMyToggle toggle("Guard for boActive", boActive);
-      std::vector<fs::path> files;
+      CheckIdle("Show");
       std::set<std::string> extensions;
       my_formlist<EMyFrameworkType::listbox, std::string> mylist(&frm, "lbValues");
       std::copy(mylist.begin(), mylist.end(), std::ostream_iterator<std::string>(std::cerr, "\n"));
@@ -209,15 +315,22 @@ void TProcess::ShowAction() {
          log.except();
          }
       else {
-         frm.GetAsStream<Latin, EMyFrameworkType::listview>(old_cout, "lvOutput", File_Columns);
-         std::chrono::milliseconds time;
+         watcher.Stop();
+         auto columns = File_Columns;
+         if(boTextColumns) columns.insert(columns.end(), Text_Columns.begin(), Text_Columns.end());
+         frm.GetAsStream<Latin, EMyFrameworkType::listview>(old_cout, "lvOutput", columns);
          fs::path fsPath = *strPath;
-         auto ret = Call(time, Find, std::ref(files), std::cref(fsPath), std::cref(extensions), true);
-
-         std::clog << " function \"Find\" procecced in "
-                   << std::setprecision(3) << time.count()/1000. << " sec, "
-                   << files.size() << " files found" << std::endl;
-         ShowFiles(std::cout, fsPath, files);
+         Run("Show", [this, fsPath, extensions]() {
+            std::chrono::milliseconds time;
+            PrepareScan(fsPath);
+            // files are shown in batches while the search is still running
+            auto show_func = [this, &fsPath](std::vector<fs::path>&& files) { ShowFiles(std::cout, fsPath, files); };
+            auto ret = Call(time, Find_Stream, std::cref(fsPath), std::cref(extensions), Find_Sink_Type(show_func), true, 256u);
+
+            std::clog << " function \"Find\" procecced in "
+                      << std::setprecision(3) << time.count()/1000. << " sec, "
+                      << ret << " files found" << std::endl;
+            });
          }
       }
    catch(std::exception& ex) {
@@ -226,28 +339,150 @@ void TProcess::ShowAction() {
       }
    }
 
+/// exclusions for the following scan from the file in the directory, if it exists
+void TProcess::PrepareScan(fs::path const& fsPath) {
+   Set_Exclude_Patterns(Read_Exclude_File(fsPath / exclude_file));
+   }
+
 /** \brief construction of filename with informations from tplData and base directory
 \tparam iFile Contant of int with the position of relative name in tplData
+\param paths resolver of the run, like fs::weakly_canonical() with the directories kept
 \param base const reference of fs::path with basic path for tplData
 \param row const reference of tplData with informations for a information in project file
 \return fs::path with the absolute path to the requested file
 */
 template <int iFile>
-fs::path ConstructFile(fs::path const& base, tplData const& row) {
-   return fs::weakly_canonical(base / fs::path(std::get<iMyData_Path>(row)) / fs::path(std::get<iFile>(row)));
+fs::path ConstructFile(TPathResolver& paths, fs::path const& base, tplData const& row) {
+   return paths.Resolve(base / fs::path(std::get<iMyData_Path>(row)) / fs::path(std::get<iFile>(row)));
 }
 
 
-/// method to parse a cbproj file for informations
-void TProcess::ParseProject(fs::path const& base, fs::path const& strFile, std::vector<tplData>& projects) {
+/// function to set a column of tplData with the text of an attribute or an element
+using tplSetter = void (*)(tplData&, char const*);
+
+template <int iColumn>
+void Set_Column(tplData& row, char const* strValue) {
+   if constexpr(std::is_same_v<std::tuple_element_t<iColumn, tplData>, int>) std::get<iColumn>(row) = atoi(strValue);
+   else std::get<iColumn>(row) = strValue;
+   }
+
+/// kind of node in the ItemGroup of a cbproj file, with the columns from its attributes and child elements
+struct TExtractKind {
+   char const* strElement;
+   char const* strType;
+   std::vector<std::pair<char const*, tplSetter>> attributes;
+   std::vector<std::pair<char const*, tplSetter>> children;
+   };
+
+enum : size_t { extract_cpp, extract_none, extract_form };   ///< positions of the kinds in Extract_Schema()
+
+/**
+   \brief schema for the extraction of the rows from the ItemGroup of a cbproj file
+   \details new columns from the nodes are added only here, ParseProject() completes
+            the rows of each kind and decides which of them are used
+*/
+std::vector<TExtractKind> const& Extract_Schema() {
+   static const std::vector<TExtractKind> schema = {
+      { "CppCompile",    "Cpp Node",  { { "Include", Set_Column<iMyData_CppFile> } },
+                                      { { "BuildOrder",  Set_Column<iMyData_Order> },
+                                        { "DependentOn", Set_Column<iMyData_H_File> },
+                                        { "Form",        Set_Column<iMyData_FrmName> },
+                                        { "FormType",    Set_Column<iMyData_FrmType> },
+                                        { "DesignClass", Set_Column<iMyData_FrmClass> } } },
+      { "None",          "None Node", { { "Include", Set_Column<iMyData_H_File> } },
+                                      { { "BuildOrder",  Set_Column<iMyData_Order> } } },
+      { "FormResources", "Form Node", { { "Include", Set_Column<iMyData_FrmFile> } },
+                                      { { "BuildOrder",  Set_Column<iMyData_Order> } } }
+      };
+   return schema;
+   }
+
+/// Extract_Schema() compiled to tables from the names to the kinds and the setters, built once
+struct TExtractTable {
+   std::unordered_map<std::string_view, size_t>                    kinds;
+   std::vector<std::unordered_map<std::string_view, tplSetter>>    attributes;
+   std::vector<std::unordered_map<std::string_view, tplSetter>>    children;
+
+   TExtractTable() {
+      auto const& schema = Extract_Schema();
+      attributes.resize(schema.size());
+      children.resize(schema.size());
+      for(size_t i = 0u; i < schema.size(); ++i) {
+         kinds.emplace(schema[i].strElement, i);
+         attributes[i].insert(schema[i].attributes.begin(), schema[i].attributes.end());
+         children[i].insert(schema[i].children.begin(), schema[i].children.end());
+         }
+      }
+   };
+
+/**
+   \brief rows of the nodes in an ItemGroup, one vector for each kind of Extract_Schema()
+   \details one pass over the nodes and their children, the names are looked up in the
+            tables. The order of the nodes of a kind is kept, the type is set.
+            For a child element used twice the first one counts, like child_value(name).
+*/
+std::vector<std::vector<tplData>> Extract_Rows(pugi::xml_node group) {
+   static const TExtractTable table;
+   auto const& schema = Extract_Schema();
+   std::vector<std::vector<tplData>> ret(schema.size());
+   for(pugi::xml_node node = group.first_child(); node; node = node.next_sibling()) {
+      auto kind = table.kinds.find(node.name());
+      if(kind == table.kinds.end()) continue;
+      const size_t iKind = kind->second;
+      auto& row = ret[iKind].emplace_back();
+      std::get<iMyData_Type>(row) = schema[iKind].strType;
+      for(pugi::xml_attribute attr = node.first_attribute(); attr; attr = attr.next_attribute()) {
+         if(auto set = table.attributes[iKind].find(attr.name()); set != table.attributes[iKind].end()) set->second(row, attr.value());
+         }
+      std::vector<tplSetter> used;
+      for(pugi::xml_node child = node.first_child(); child; child = child.next_sibling()) {
+         auto set = table.children[iKind].find(child.name());
+         if(set == table.children[iKind].end() || std::find(used.begin(), used.end(), set->second) != used.end()) continue;
+         set->second(row, child.child_value());
+         used.emplace_back(set->second);
+         }
+      }
+   return ret;
+   }
+
+/**
+   \brief method to parse a cbproj file for informations, the files for the rows are only collected
+   \details called concurrently for different projects, every call has its own document and
+            vectors. Nodes for headers and forms are only checked against the rows of this
+            project, Parse() checks them against the projects before.
+            The file is parsed in place in a private copy, only up to the first ItemGroup and
+            without the processing of end of lines and whitespace, which isn't needed for them.
+   \param paths resolver for the paths of the files, shared by the projects of a run
+   \param err stream for the errors of the project
+*/
+void TProcess::ParseProject(fs::path const& base, fs::path const& strFile, std::vector<tplData>& projects,
+                            std::vector<TRowRequest>& requests, TPathResolver& paths, std::ostream& err) {
+   // headers and forms of the rows of this project, the nodes for them are skipped
+   std::unordered_set<std::string> header_seen, form_seen;
+
+   // the files are constructed before the row is added, an exception leaves no request without row
+   auto add_row = [&projects, &requests, &header_seen, &form_seen](tplData&& row, std::vector<std::pair<int, fs::path>>&& files) {
+               for(auto& [iColumn, file] : files) requests.push_back({ projects.size(), iColumn, std::move(file) });
+               if(!std::get<iMyData_H_File>(row).empty()) header_seen.insert(std::get<iMyData_H_File>(row));
+               if(!std::get<iMyData_FrmFile>(row).empty()) form_seen.insert(std::get<iMyData_FrmFile>(row));
+               projects.emplace_back(std::move(row));
+               };
+
    auto xml_error = [&strFile](std::ostream& out, pugi::xml_parse_result result) {
                out << "XML [" << strFile.string() << "] parsed with errors" << std::endl
                    << "Error description: " << result.description() << std::endl
                    << "Error offset: " << result.offset << std::endl;
                };
    try {
+      TFileCopy content(strFile);     // text of the nodes, must live longer than the document
       pugi::xml_document doc;
-      pugi::xml_parse_result result = doc.load_file(strFile.string().c_str(), pugi::parse_default | pugi::parse_fragment);
+      const size_t iPart = Cut_After_ItemGroup(content.data(), content.size());
+      pugi::xml_parse_result result = doc.load_buffer_inplace(content.data(), iPart, pugi::parse_minimal | pugi::parse_escapes | pugi::parse_fragment);
+      content.Check();              // the file wasn't truncated under the parser
+      if(!result && iPart < content.size()) {
+         // the first ItemGroup isn't a child of the root, the whole file as before
+         result = doc.load_file(strFile.string().c_str(), pugi::parse_default | pugi::parse_fragment);
+         }
 
       if(!result) {
          TMyLogger log(__func__, __FILE__, __LINE__);
@@ -255,31 +490,26 @@ void TProcess::ParseProject(fs::path const& base, fs::path const& strFile, std::
          log.except();
          }
 
-      pugi::xml_node root = doc.document_element();
-      pugi::xpath_node xpathNode = root.select_node("ItemGroup");
-      if(!xpathNode) {
+      pugi::xml_node group = doc.document_element().child("ItemGroup");
+      if(!group) {
          TMyLogger log(__func__, __FILE__, __LINE__);
          log.stream() << "ItemGroup not found in file " << strFile.string();
          log.except();
          }
-      pugi::xml_node selNode = xpathNode.node();
-      for(pugi::xml_node child = selNode.child("CppCompile"); child; child = child.next_sibling("CppCompile")) {
-         tplData row;
-         std::get<iMyData_Project>(row)  = strFile.filename().string();
-         std::get<iMyData_Path>(row)     = fs::relative(strFile.parent_path(), base).string();
-         std::get<iMyData_Type>(row)     = "Cpp Node";
-         std::get<iMyData_Order>(row)    = atoi(child.child_value("BuildOrder"));
-         std::get<iMyData_CppFile>(row)  = child.attribute("Include").value();
-         std::get<iMyData_H_File>(row)   = child.child_value("DependentOn");
-         std::get<iMyData_FrmName>(row)  = child.child_value("Form");
-         std::get<iMyData_FrmType>(row)  = child.child_value("FormType");
-         std::get<iMyData_FrmClass>(row) = child.child_value("DesignClass");
-
+      auto nodes = Extract_Rows(group);
+      content.Check();
+      const std::string strProject = strFile.filename().string();
+      const std::string strPath    = paths.Resolve(strFile.parent_path()).lexically_relative(paths.Resolve(base)).string();   // fs::relative()
+      for(auto& row : nodes[extract_cpp]) {
+         std::get<iMyData_Project>(row) = strProject;
+         std::get<iMyData_Path>(row)    = strPath;
+
+         std::vector<std::pair<int, fs::path>> files;
          if(!std::get<iMyData_CppFile>(row).empty())
-            std::get<iMyData_CppRows>(row) =CheckFileSize(ConstructFile<iMyData_CppFile>(base, row));
+            files.emplace_back(iMyData_CppRows, ConstructFile<iMyData_CppFile>(paths, base, row));
 
          if(!std::get<iMyData_H_File>(row).empty())
-            std::get<iMyData_H_Rows>(row) =CheckFileSize(ConstructFile<iMyData_H_File>(base, row));
+            files.emplace_back(iMyData_H_Rows, ConstructFile<iMyData_H_File>(paths, base, row));
 
          if(!std::get<iMyData_FrmName>(row).empty()) {
             std::string strExt;
@@ -288,59 +518,130 @@ void TProcess::ParseProject(fs::path const& base, fs::path const& strFile, std::
             std::get<iMyData_FrmFile>(row) = ( fs::path(std::get<iMyData_CppFile>(row)).parent_path() /
                                                fs::path(std::get<iMyData_CppFile>(row)).stem()).string() +
                                                strExt;
-            std::get<iMyData_FrmRows>(row) =CheckFileSize(ConstructFile<iMyData_FrmFile>(base, row));
+            files.emplace_back(iMyData_FrmRows, ConstructFile<iMyData_FrmFile>(paths, base, row));
             }
 
-         projects.emplace_back(std::move(row));
+         add_row(std::move(row), std::move(files));
          }
 
-      for(pugi::xml_node child = selNode.child("None"); child; child = child.next_sibling("None")) {
-         std::string strCurrentFile = child.attribute("Include").value();
-         std::string strCurrentExtension = fs::path(strCurrentFile).extension().string();
-         if(header_files.find(strCurrentExtension) != header_files.end()) {
-            tplData row;
-            if(auto it = std::find_if(projects.begin(), projects.end(), [strCurrentFile](auto const& val) {
-                  return strCurrentFile == std::get<iMyData_H_File>(val);
-                               });it == projects.end()) {
-               std::get<iMyData_Project>(row) = strFile.filename().string();
-               std::get<iMyData_Path>(row)    = fs::relative(strFile.parent_path(), base).string();
-               std::get<iMyData_Type>(row)    = "None Node";
-               std::get<iMyData_Order>(row)   = atoi(child.child_value("BuildOrder"));
-               std::get<iMyData_H_File>(row)  = strCurrentFile;
+      for(auto& row : nodes[extract_none]) {
+         auto const& strCurrentFile = std::get<iMyData_H_File>(row);
+         if(header_files.find(fs::path(strCurrentFile).extension().string()) != header_files.end() &&
+            header_seen.find(strCurrentFile) == header_seen.end()) {
+            std::get<iMyData_Project>(row) = strProject;
+            std::get<iMyData_Path>(row)    = strPath;
 
-               if(!std::get<iMyData_H_File>(row).empty())
-                  std::get<iMyData_H_Rows>(row) =CheckFileSize(ConstructFile<iMyData_H_File>(base, row));
+            std::vector<std::pair<int, fs::path>> files;
+            if(!std::get<iMyData_H_File>(row).empty())
+               files.emplace_back(iMyData_H_Rows, ConstructFile<iMyData_H_File>(paths, base, row));
 
-               projects.emplace_back(std::move(row));
-               }
+            add_row(std::move(row), std::move(files));
             }
          }
 
-       for(pugi::xml_node child = selNode.child("FormResources"); child; child = child.next_sibling("FormResources")) {
-          std::string strCurrentFile = child.attribute("Include").value();
-          std::string strCurrentExtension = fs::path(strCurrentFile).extension().string();
-          if(form_files.find(strCurrentExtension) != form_files.end()) {
-             tplData row;
-             if(auto it = std::find_if(projects.begin(), projects.end(), [strCurrentFile](auto const& val) {
-                  return strCurrentFile == std::get<iMyData_FrmFile>(val);
-                               });it == projects.end()) {
-                std::get<iMyData_Project>(row) = strFile.filename().string();
-                std::get<iMyData_Path>(row)    = fs::relative(strFile.parent_path(), base).string();
-                std::get<iMyData_Type>(row)    = "Form Node";
-                std::get<iMyData_Order>(row)   = atoi(child.child_value("BuildOrder"));
-                std::get<iMyData_FrmFile>(row) = strCurrentFile;
-
-                if(!std::get<iMyData_FrmFile>(row).empty())
-                   std::get<iMyData_FrmRows>(row) =CheckFileSize(ConstructFile<iMyData_FrmFile>(base, row));
-
-                projects.emplace_back(std::move(row));
-                }
-             }
-          }
+      for(auto& row : nodes[extract_form]) {
+         auto const& strCurrentFile = std::get<iMyData_FrmFile>(row);
+         if(form_files.find(fs::path(strCurrentFile).extension().string()) != form_files.end() &&
+            form_seen.find(strCurrentFile) == form_seen.end()) {
+            std::get<iMyData_Project>(row) = strProject;
+            std::get<iMyData_Path>(row)    = strPath;
+
+            std::vector<std::pair<int, fs::path>> files;
+            if(!std::get<iMyData_FrmFile>(row).empty())
+               files.emplace_back(iMyData_FrmRows, ConstructFile<iMyData_FrmFile>(paths, base, row));
+
+            add_row(std::move(row), std::move(files));
+            }
+         }
       }
    catch(std::exception& ex) {
-      std::cerr << ex.what() << std::endl;
+      err << ex.what() << std::endl;
+      }
+   }
+
+/// kind of the line ends for the text columns, the counts (LF/CRLF/CR) when they are mixed
+std::string Line_Ends(TTextStats const& stats) {
+   const int iKinds = (stats.iLF > 0u) + (stats.iCRLF > 0u) + (stats.iCR > 0u);
+   if(iKinds == 0) return "";
+   if(iKinds > 1) return "mixed " + std::to_string(stats.iLF) + "/" + std::to_string(stats.iCRLF) + "/" + std::to_string(stats.iCR);
+   return stats.iLF > 0u ? "LF" : (stats.iCRLF > 0u ? "CRLF" : "CR");
+   }
+
+/// values of the text columns with a leading tab
+std::string Text_Values(TTextStats const& stats) {
+   return '\t' + std::to_string(stats.iWords) + '\t' + std::to_string(stats.iLongest) + '\t' + Line_Ends(stats);
+   }
+
+/**
+   \brief second stage of Parse(), rows of all collected files with a pool of workers
+   \details a file referenced by several rows or projects is counted only once, unchanged
+            files are taken from the content cache of the scanned directory. The lines
+            are classified in the same pass, sources as C++, forms as text. With row_text
+            the wc- style statistic of the files of every row is built in the same pass too,
+            the histogram of the line lengths of all files is reported
+   \returns sums of the kinds of lines for source files and for form files, like the rows
+*/
+std::pair<TLineStats, TLineStats> CountRows(fs::path const& fsPath, std::vector<tplData>& projects,
+                                            std::vector<TRowRequest> const& requests,
+                                            std::vector<TTextStats>* row_text = nullptr) {
+   std::vector<fs::path>    files;
+   std::vector<ELineSyntax> syntax;
+   std::vector<size_t>      file_of(requests.size());
+   std::unordered_map<fs::path::string_type, size_t> known;
+   for(size_t i = 0u; i < requests.size(); ++i) {
+      auto [it, boNew] = known.emplace(requests[i].file.native(), files.size());
+      if(boNew) {
+         files.emplace_back(requests[i].file);
+         syntax.emplace_back(requests[i].iColumn == iMyData_FrmRows ? ELineSyntax::text : ELineSyntax::cpp);
+         }
+      file_of[i] = it->second;
+      }
+
+   std::pair<TLineStats, TLineStats> ret;
+   std::vector<TTextStats> text;
+   const auto lines = row_text ? Count_Lines(files, syntax, Content_Cache_File(fsPath), text)
+                               : Count_Lines(files, syntax, Content_Cache_File(fsPath));
+   if(row_text) {
+      row_text->assign(projects.size(), TTextStats { });
+      for(size_t i = 0u; i < requests.size(); ++i) (*row_text)[requests[i].iRow] += text[file_of[i]];
+
+      TTextStats total;
+      for(auto const& val : text) total += val;
+      const auto iUsed = std::find_if(total.lengths.rbegin(), total.lengths.rend(), [](auto val) { return val > 0u; }) - total.lengths.rbegin();
+      std::cerr << "line lengths in files (empty, 1, 2-3, 4-7, ...): (";
+      for(size_t i = 0u; i < total.lengths.size() - static_cast<size_t>(iUsed); ++i) std::cerr << (i > 0u ? ", " : "") << total.lengths[i];
+      std::cerr << ")" << std::endl
+                << "line ends in files (LF, CRLF, CR): (" << total.iLF << ", " << total.iCRLF << ", " << total.iCR << "), "
+                << "longest line " << total.iLongest << ", " << total.iWords << " words" << std::endl;
+      }
+
+   for(size_t i = 0u; i < requests.size(); ++i) {
+      auto& row = projects[requests[i].iRow];
+      auto const& stats = lines[file_of[i]];
+      const auto iRows  = static_cast<size_t>(stats.iRows);
+      switch(requests[i].iColumn) {
+         case iMyData_CppRows: std::get<iMyData_CppRows>(row) = iRows; break;
+         case iMyData_H_Rows:  std::get<iMyData_H_Rows>(row)  = iRows; break;
+         case iMyData_FrmRows: std::get<iMyData_FrmRows>(row) = iRows; break;
+         }
+      auto& sum = requests[i].iColumn == iMyData_FrmRows ? ret.second : ret.first;
+      sum.iRows         += stats.iRows;
+      sum.iCode         += stats.iCode;
+      sum.iComment      += stats.iComment;
+      sum.iBlank        += stats.iBlank;
+      sum.iPreprocessor += stats.iPreprocessor;
+      }
+
+   size_t iBinaryForms = 0u, iBinary = 0u;
+   for(auto const& stats : lines) {
+      if(stats.eKind == EContentKind::form_binary) ++iBinaryForms;
+      else if(stats.eKind == EContentKind::binary) ++iBinary;
+      }
+   if(iBinaryForms + iBinary > 0u) {
+      std::cerr << iBinaryForms << " binary form file(s) and " << iBinary << " other binary file(s) found, "
+                << (Get_Binary_Policy() == EBinaryPolicy::count ? "counted as text" : "counted with 0 rows") << std::endl;
       }
+   return ret;
    }
 
 void TProcess::Parse(fs::path const& fsPath, std::vector<fs::path>& project_files, std::vector<tplData>& projects) {
@@ -350,7 +651,61 @@ void TProcess::Parse(fs::path const& fsPath, std::vector<fs::path>& project_file
              << "procecced in " << std::setprecision(3) << time.count()/1000. << " sec" << std::endl;
 
 
-   for(auto file : project_files) ParseProject(fsPath, file, projects);
+   // the projects are parsed by a pool of workers, each into its own buffer. The buffers are
+   // appended in the order of project_files, so the result doesn't depend on the scheduling
+   struct TParsed {
+      std::vector<tplData>     projects;
+      std::vector<TRowRequest> requests;
+      std::ostringstream       errors;
+      };
+   std::vector<TParsed> parsed(project_files.size());
+   TPathResolver        paths;
+   std::atomic<size_t>  next { 0u };
+   auto& control = Scan_Control();
+   auto worker = [&]() {
+      for(size_t i; (i = next++) < project_files.size(); ) {
+         if(control.Cancelled()) break;
+         ParseProject(fsPath, project_files[i], parsed[i].projects, parsed[i].requests, paths, parsed[i].errors);
+         }
+      };
+   const size_t iWorkers = std::min<size_t>(Get_Traversal_Threads(), project_files.size());
+   std::vector<std::thread> threads;
+   for(size_t i = 1u; i < iWorkers; ++i) threads.emplace_back(worker);
+   worker();
+   std::for_each(threads.begin(), threads.end(), [](auto& thread) { thread.join(); });
+   control.Check();
+
+   // nodes of headers and forms which an earlier project has already are dropped, like the project does it itself
+   std::vector<TRowRequest> requests;
+   std::unordered_set<std::string> header_seen, form_seen;   // files of the rows of the projects appended before
+   for(auto& part : parsed) {
+      if(auto strErrors = part.errors.str(); !strErrors.empty()) std::cerr << strErrors;
+      const size_t iDropped = std::numeric_limits<size_t>::max();
+      const size_t iBefore  = projects.size();
+      std::vector<size_t> row_of(part.projects.size());
+      for(size_t i = 0u; i < part.projects.size(); ++i) {
+         auto& row = part.projects[i];
+         if((std::get<iMyData_Type>(row) == "None Node" && header_seen.count(std::get<iMyData_H_File>(row)) > 0u) ||
+            (std::get<iMyData_Type>(row) == "Form Node" && form_seen.count(std::get<iMyData_FrmFile>(row)) > 0u)) {
+            row_of[i] = iDropped;
+            }
+         else {
+            row_of[i] = projects.size();
+            projects.emplace_back(std::move(row));
+            }
+         }
+      for(size_t i = iBefore; i < projects.size(); ++i) {
+         if(!std::get<iMyData_H_File>(projects[i]).empty()) header_seen.insert(std::get<iMyData_H_File>(projects[i]));
+         if(!std::get<iMyData_FrmFile>(projects[i]).empty()) form_seen.insert(std::get<iMyData_FrmFile>(projects[i]));
+         }
+      for(auto& request : part.requests) {
+         if(row_of[request.iRow] == iDropped) continue;
+         request.iRow = row_of[request.iRow];
+         requests.emplace_back(std::move(request));
+         }
+      }
+   std::vector<TTextStats> row_text;
+   const auto [sources, forms] = CountRows(fsPath, projects, requests, boTextColumns ? &row_text : nullptr);
 
    std::tuple<size_t, size_t, size_t> rows = { 0u, 0u, 0u };
    std::for_each(projects.begin(), projects.end(), [&rows](auto const& val) {
@@ -368,8 +723,18 @@ void TProcess::Parse(fs::path const& fsPath, std::vector<fs::path>& project_file
    std:: cerr << "count of rows in files (cpp, h, form): ";
    TMyDelimiter<Latin> delimiter = { "(", ", ", ")\n" };
    myTupleHlp<Latin>::Output(std::cerr, delimiter, rows);
-
-   std::sort(projects.begin(), projects.end(), [](auto lhs, auto rhs) {
+   std::cerr << "lines in source files (code, comment, blank, preprocessor): ";
+   myTupleHlp<Latin>::Output(std::cerr, delimiter, std::make_tuple(static_cast<size_t>(sources.iCode), static_cast<size_t>(sources.iComment),
+                                                                   static_cast<size_t>(sources.iBlank), static_cast<size_t>(sources.iPreprocessor)));
+   std::cerr << "lines in form files (content, blank): ";
+   myTupleHlp<Latin>::Output(std::cerr, delimiter, std::make_tuple(static_cast<size_t>(forms.iCode), static_cast<size_t>(forms.iBlank)));
+
+   // sorted by position, so the text columns stay with their rows
+   std::vector<size_t> order(projects.size());
+   std::iota(order.begin(), order.end(), size_t { 0u });
+   std::sort(order.begin(), order.end(), [&projects](size_t iLhs, size_t iRhs) {
+                      auto const& lhs = projects[iLhs];
+                      auto const& rhs = projects[iRhs];
                       if(auto ret = std::get<iMyData_Project>(lhs).compare(std::get<iMyData_Project>(rhs)); ret == 0) {
                          if(auto ret = std::get<iMyData_Path>(lhs).compare(std::get<iMyData_Path>(rhs)); ret == 0) {
                             return std::get<iMyData_Order>(lhs) < std::get<iMyData_Order>(rhs);
@@ -379,17 +744,20 @@ void TProcess::Parse(fs::path const& fsPath, std::vector<fs::path>& project_file
                       else return ret < 0;
                       });
 
-   delimiter = { "", "\t", "\n" };
-   std::for_each(projects.begin(), projects.end(), [&delimiter](auto val) {
-          myTupleHlp<Latin>::Output(std::cout, delimiter, val);
-          });
+   delimiter = { "", "\t", row_text.empty() ? "\n" : "" };
+   std::vector<tplData> sorted;
+   sorted.reserve(projects.size());
+   for(auto idx : order) {
+      myTupleHlp<Latin>::Output(std::cout, delimiter, projects[idx]);
+      if(!row_text.empty()) std::cout << Text_Values(row_text[idx]) << '\n';
+      sorted.emplace_back(std::move(projects[idx]));
+      }
+   projects = std::move(sorted);
    }
 
 void TProcess::ParseAction() {
-   std::vector<fs::path> project_files;
-   std::vector<tplData> projects;
-
    try {
+      CheckIdle("Parse");
       auto strPath = frm.Get<EMyFrameworkType::edit, std::string>("edtDirectory");
       if(!strPath) {
          TMyLogger log(__func__, __FILE__, __LINE__);
@@ -397,8 +765,17 @@ void TProcess::ParseAction() {
          log.except();
          }
 
-      frm.GetAsStream<Latin, EMyFrameworkType::listview>(old_cout, "lvOutput", Project_Columns);
-      Parse(*strPath, project_files, projects);
+      watcher.Stop();
+      auto columns = Project_Columns;
+      if(boTextColumns) columns.insert(columns.end(), Text_Columns.begin(), Text_Columns.end());
+      frm.GetAsStream<Latin, EMyFrameworkType::listview>(old_cout, "lvOutput", columns);
+      fs::path fsPath = *strPath;
+      Run("Parse", [this, fsPath]() {
+         std::vector<fs::path> project_files;
+         std::vector<tplData> projects;
+         PrepareScan(fsPath);
+         Parse(fsPath, project_files, projects);
+         });
       }
    catch(std::exception &ex) {
       std::cerr << "error in function \"Parse\": " << ex.what() << std::endl;
@@ -406,8 +783,13 @@ void TProcess::ParseAction() {
       }
    }
 
+/**
+   \brief count files, directories and size of the selected directory
+   \details all directories are read, with the parallel walk for several threads
+*/
 void TProcess::CountAction() {
    try {
+      CheckIdle("Count");
       auto strPath = frm.Get<EMyFrameworkType::edit, std::string>("edtDirectory");
       if(!strPath) {
          TMyLogger log(__func__, __FILE__, __LINE__);
@@ -415,15 +797,17 @@ void TProcess::CountAction() {
          log.except();
          }
       else {
+         watcher.Stop();
          frm.GetAsStream<Latin, EMyFrameworkType::listview>(old_cout, "lvOutput", Count_Columns);
-         std::chrono::milliseconds time;
          fs::path fsPath = *strPath;
-         auto ret = Call(time, Count, std::cref(fsPath), true);
-         std::get<2>(ret) = Convert_Size_KiloByte(std::get<2>(ret));
-         TMyDelimiter<Latin> delimiter = { "", "\t", "\n" };
-         myTupleHlp<Latin>::Output(std::cout, delimiter, ret);
-         std::clog << "function \"Count\" procecced in "
-                   << std::setprecision(3) << time.count()/1000. << " sec" << std::endl;
+         Run("Count", [this, fsPath]() {
+            std::chrono::milliseconds time;
+            PrepareScan(fsPath);
+            auto ret = Call(time, Count, std::cref(fsPath), true);
+            WriteCount(ret);
+            std::clog << "function \"Count\" procecced in "
+                      << std::setprecision(3) << time.count()/1000. << " sec" << std::endl;
+            });
          }
       }
    catch(std::exception &ex) {
@@ -432,50 +816,351 @@ void TProcess::CountAction() {
       }
    }
 
+/**
+   \brief incremental count of the selected directory with the snapshot of the last run
+   \details the values of directories with an unchanged signature are taken from the
+            snapshot, which is kept in the cache directory of the user (Snapshot_File(),
+            FileApp below XDG_CACHE_HOME or LOCALAPPDATA). A file changed in place doesn't
+            change the signature of its directory, its old size stays in the totals until
+            a full rescan.
+   \param boFullRescan [IN] read all directories again and rebuild the snapshot
+*/
+void TProcess::SnapshotAction(bool boFullRescan) {
+   const std::string strAction = boFullRescan ? "Rescan" : "Snapshot";
+   try {
+      CheckIdle(strAction);
+      auto strPath = frm.Get<EMyFrameworkType::edit, std::string>("edtDirectory");
+      if(!strPath) {
+         TMyLogger log(__func__, __FILE__, __LINE__);
+         log.stream() << "directory to count is empty, set a directory before call this function";
+         log.except();
+         }
+      else {
+         watcher.Stop();
+         frm.GetAsStream<Latin, EMyFrameworkType::listview>(old_cout, "lvOutput", Count_Columns);
+         fs::path fsPath = *strPath;
+         Run(strAction, [this, fsPath, boFullRescan, strAction]() {
+            std::chrono::milliseconds time;
+            PrepareScan(fsPath);
+            auto snapshot = Snapshot_File(fsPath);
+            auto ret = Call(time, Count_Snapshot, std::cref(fsPath), std::cref(snapshot), boFullRescan);
+            WriteCount(ret);
+            std::clog << "function \"" << strAction << "\" procecced in "
+                      << std::setprecision(3) << time.count()/1000. << " sec" << std::endl;
+            });
+         }
+      }
+   catch(std::exception &ex) {
+      std::cerr << "error in function \"" << strAction << "\": " << ex.what() << std::endl;
+      std::clog << "error in function \"" << strAction << "\"" << std::endl;
+      }
+   }
+
+/**
+   \brief count the selected directory and keep the values current with live mode
+   \details after the initial count all directories are watched, changes are
+            applied with WatchPoll()
+*/
+void TProcess::WatchAction() {
+   try {
+      CheckIdle("Watch");
+      auto strPath = frm.Get<EMyFrameworkType::edit, std::string>("edtDirectory");
+      if(!strPath) {
+         TMyLogger log(__func__, __FILE__, __LINE__);
+         log.stream() << "directory to watch is empty, set a directory before call this function";
+         log.except();
+         }
+      else {
+         frm.GetAsStream<Latin, EMyFrameworkType::listview>(old_cout, "lvOutput", Count_Columns);
+         fs::path fsPath = *strPath;
+         Run("Watch", [this, fsPath]() {
+            std::chrono::milliseconds time;
+            PrepareScan(fsPath);
+            auto ret = Call(time, [this](fs::path const& p) { return watcher.Start(p); }, std::cref(fsPath));
+            WriteCount(ret);
+            std::clog << "function \"Watch\" procecced in "
+                      << std::setprecision(3) << time.count()/1000. << " sec, "
+                      << watcher.Unwatched() << " directories without watch" << std::endl;
+            });
+         }
+      }
+   catch(std::exception &ex) {
+      std::cerr << "error in function \"Watch\": " << ex.what() << std::endl;
+      std::clog << "error in function \"Watch\"" << std::endl;
+      }
+   }
+
+/// update of the live mode, called by Poll(), output only when the values changed
+void TProcess::WatchPoll() {
+   if(boActive || !watcher.Active()) return;
+   try {
+      if(watcher.Update()) ShowCount(watcher.Totals());
+      }
+   catch(std::exception &ex) {
+      std::cerr << "error in function \"Watch\": " << ex.what() << std::endl;
+      }
+   }
+
+/**
+   \brief show the largest subdirectories and files of the selected directory
+   \details subtotals for all directories are built with one walk, the largest files
+            follow the directories with empty columns for files and directories
+   \param iTop [IN] count of directories and files to show
+*/
+void TProcess::UsageAction(size_t iTop) {
+   try {
+      CheckIdle("Usage");
+      auto strPath = frm.Get<EMyFrameworkType::edit, std::string>("edtDirectory");
+      if(!strPath) {
+         TMyLogger log(__func__, __FILE__, __LINE__);
+         log.stream() << "directory to analyze is empty, set a directory before call this function";
+         log.except();
+         }
+      else {
+         watcher.Stop();
+         frm.GetAsStream<Latin, EMyFrameworkType::listview>(old_cout, "lvOutput", Usage_Columns);
+         fs::path fsPath = *strPath;
+         Run("Usage", [this, fsPath, iTop]() {
+            std::chrono::milliseconds time;
+            PrepareScan(fsPath);
+            TDirTree tree;
+            auto ret = Call(time, Count_Tree, std::cref(fsPath), std::ref(tree), iTop);
+
+            for(auto idx : tree.Top_Directories(iTop)) {
+               auto values = tree.Total(idx);
+               std::cout << fs::relative(tree.Path(idx), fsPath).string() << '\t'
+                         << std::get<0>(values) << '\t' << std::get<1>(values) << '\t'
+                         << Convert_Size_KiloByte(std::get<2>(values)) << " KB" << std::endl;
+               }
+            for(auto const& [file, size] : tree.Top_Files()) {
+               std::cout << fs::relative(file, fsPath).string() << "\t\t\t"
+                         << Convert_Size_KiloByte(size) << " KB" << std::endl;
+               }
+
+            std::clog << "function \"Usage\" procecced in "
+                      << std::setprecision(3) << time.count()/1000. << " sec, "
+                      << tree.Size() << " directories, "
+                      << Convert_Size_KiloByte(std::get<2>(ret)) << " KB" << std::endl;
+            });
+         }
+      }
+   catch(std::exception &ex) {
+      std::cerr << "error in function \"Usage\": " << ex.what() << std::endl;
+      std::clog << "error in function \"Usage\"" << std::endl;
+      }
+   }
+
+/**
+   \brief show the groups of files with the same content in the selected directory
+   \details only files whose size is shared by another file are read, the fingerprints
+            of unchanged files come from the content cache of the directory. The
+            groups with the largest files come first.
+*/
+void TProcess::DuplicatesAction() {
+   try {
+      CheckIdle("Duplicates");
+      auto strPath = frm.Get<EMyFrameworkType::edit, std::string>("edtDirectory");
+      if(!strPath) {
+         TMyLogger log(__func__, __FILE__, __LINE__);
+         log.stream() << "directory to analyze is empty, set a directory before call this function";
+         log.except();
+         }
+      else {
+         watcher.Stop();
+         frm.GetAsStream<Latin, EMyFrameworkType::listview>(old_cout, "lvOutput", Duplicates_Columns);
+         fs::path fsPath = *strPath;
+         Run("Duplicates", [this, fsPath]() {
+            std::chrono::milliseconds time;
+            PrepareScan(fsPath);
+            std::vector<fs::path> files;
+            Find_All(files, fsPath, true);
+            auto groups = Call(time, Find_Duplicates, std::cref(files), Content_Cache_File(fsPath));
+
+            size_t iGroup = 0u, iDuplicates = 0u;
+            std::uintmax_t iWasted = 0u;
+            for(auto const& group : groups) {
+               ++iGroup;
+               for(auto const& file : group.files) {
+                  std::cout << fs::relative(file, fsPath).string() << '\t'
+                            << iGroup << '\t' << Convert_Size_KiloByte(group.iSize) << " KB" << std::endl;
+                  }
+               iDuplicates += group.files.size() - 1u;
+               iWasted     += group.iSize * (group.files.size() - 1u);
+               }
+
+            std::clog << "function \"Duplicates\" procecced in "
+                      << std::setprecision(3) << time.count()/1000. << " sec, "
+                      << files.size() << " files, " << groups.size() << " groups, "
+                      << iDuplicates << " duplicates, " << Convert_Size_KiloByte(iWasted) << " KB" << std::endl;
+            });
+         }
+      }
+   catch(std::exception &ex) {
+      std::cerr << "error in function \"Duplicates\": " << ex.what() << std::endl;
+      std::clog << "error in function \"Duplicates\"" << std::endl;
+      }
+   }
+
+/// cancel the running action, the traversal stops at the next directory
+void TProcess::CancelAction() {
+   if(boActive) Scan_Control().Cancel();
+   }
+
+/**
+   \brief to call from a timer of the framework (about every 100 ms)
+   \details passes the output of the running action to the controls, shows the progress
+            in the status bar and finishes the action. Without an action the live
+            mode is updated.
+*/
+void TProcess::Poll() {
+   if(boActive) {
+      if(boFinished) {
+         Finish();
+         return;
+         }
+      for(auto& buffer : posted) buffer->Flush();
+      if(auto now = std::chrono::steady_clock::now(); now - last_progress >= progress_interval) {
+         last_progress = now;
+         auto const& control = Scan_Control();
+         std::ostream status(posted.back()->Target());   // std::clog, status bar
+         status.imbue(myLoc);
+         status << "function \"" << strRunning << "\" running: "
+                << control.Dirs() << " directories, "
+                << control.Files() << " files, "
+                << Convert_Size_KiloByte(control.Bytes()) << " KB" << std::endl;
+         }
+      }
+   else WatchPoll();
+   }
+
+/// only one action at a time, the streams are redirected while it runs
+void TProcess::CheckIdle(std::string const& strAction) const {
+   if(boActive) {
+      TMyLogger log(__func__, __FILE__, __LINE__);
+      log.stream() << "function \"" << strRunning << "\" is running, cancel it before starting \"" << strAction << "\"";
+      log.except();
+      }
+   }
+
+/**
+   \brief start the action in a worker thread
+   \details the output to the streams is collected and passed to the controls in Poll(),
+            errors and a cancellation end the action with a message
+*/
+void TProcess::Run(std::string const& strAction, std::function<void ()> action) {
+   CheckIdle(strAction);
+   Scan_Control().Reset();
+   auto mode = read_modes.find(strAction);
+   Set_Read_Mode(mode != read_modes.end() ? mode->second : EReadMode::cached);
+   for(auto stream : { &std::cout, &std::cerr, &std::clog } ) posted.emplace_back(std::make_unique<TPostBuffer>(*stream));
+   strRunning    = strAction;
+   last_progress = std::chrono::steady_clock::now();
+   boFinished    = false;
+   boActive      = true;
+   try {
+      worker = std::thread([this, strAction, action]() {
+         try {
+            action();
+            }
+         catch(TScanCancelled const&) {
+            std::clog << "function \"" << strAction << "\" cancelled" << std::endl;
+            }
+         catch(std::exception& ex) {
+            std::cerr << "error in function \"" << strAction << "\": " << ex.what() << std::endl;
+            std::clog << "error in function \"" << strAction << "\"" << std::endl;
+            }
+         boFinished = true;
+         });
+      }
+   catch(...) {
+      posted.clear();
+      boActive = false;
+      throw;
+      }
+   }
+
+/// end of the action, the rest of the output and the streams back to the controls
+void TProcess::Finish() {
+   if(worker.joinable()) worker.join();
+   for(auto& buffer : posted) buffer->Flush(true);
+   posted.clear();
+   boActive = false;
+   Scan_Control().Reset();
+   }
+
+void TProcess::ShowCount(Dir_Stats_Type values) {
+   frm.GetAsStream<Latin, EMyFrameworkType::listview>(old_cout, "lvOutput", Count_Columns);
+   WriteCount(values);
+   }
+
+void TProcess::WriteCount(Dir_Stats_Type values) {
+   std::get<2>(values) = Convert_Size_KiloByte(std::get<2>(values));
+   TMyDelimiter<Latin> delimiter = { "", "\t", "\n" };
+   myTupleHlp<Latin>::Output(std::cout, delimiter, values);
+   }
+
 // C++20 format for date time, C++Builder only C++17
+// status of all files in one batch with the metadata stage, not with single calls
+// with decompression compressed files get the size of their content, read with a window,
+// with the text columns all files are read once for the wc- style statistic
 void TProcess::ShowFiles(std::ostream& out, fs::path const& strBase, std::vector<fs::path> const& files) {
-#if (defined(_MSVC_LANG) && _MSVC_LANG < 202002L)
-   // to_time_t C++17
-   // inspiration: https://developercommunity.visualstudio.com/t/stdfilesystemfile-time-type-does-not-allow-easy-co/251213
-   // returns loctime ready for use in std::put_time
-   auto filetime_to_localtime = [](fs::path const& p)
-   {
-      //magic number in nanoseconds?: 
-      auto constexpr __std_fs_file_time_epoch_adjustment = 0x19DB1DED53E8000LL;
-      constexpr fs::file_time_type::duration adjustment(__std_fs_file_time_epoch_adjustment);
-      auto toSeconds = [](const auto duration) {
-         // divide by 1000000 in chrono-style
-         return std::chrono::duration_cast<std::chrono::seconds>(duration);
-      };
-
-      auto ftime = std::filesystem::last_write_time(p);
-      const auto epoch = ftime.time_since_epoch();
-      time_t tt{ toSeconds(epoch - adjustment).count() };
+   auto to_localtime = [](std::time_t tt) {
       std::tm loctime;
+#if (defined(_MSVC_LANG) && _MSVC_LANG < 202002L)
       localtime_s(&loctime, &tt);
-      return loctime;
-   };
-#else 
-   auto filetime_to_localtime = [](fs::path const& p) {
-      auto ftime = fs::last_write_time(p);
-      auto tt = decltype(ftime)::clock::to_time_t(ftime);
-      std::tm loctime;
+#else
       std::localtime_s(&tt, &loctime);
-      return loctime;
-   };
 #endif
+      return loctime;
+      };
 
-   std::for_each(files.begin(), files.end(), [&out, strBase, &filetime_to_localtime](auto p) {
-              if(fs::is_directory(p)) {
-                 std::cout << fs::relative(p, strBase) << std::endl;
-                 }
-              else {
-                 auto loctime = filetime_to_localtime(p);
-                 out << fs::relative(p, strBase).string() << '\t'
-                     << std::put_time(&loctime, "%d.%m.%Y %T") << '\t'
-                     << Convert_Size_KiloByte(fs::file_size(p)) << " KB" << std::endl;
-                 }
-              });
+   auto status = Stat_Files(files);
+   std::vector<std::string> content(files.size());
+   if(Get_Decompression()) {
+      std::vector<size_t>   packed;
+      std::vector<fs::path> packed_files;
+      for(size_t i = 0u; i < files.size(); ++i) {
+         if(status[i].boValid && status[i].boRegular && Is_Compressed_Name(files[i])) {
+            packed.emplace_back(i);
+            packed_files.emplace_back(files[i]);
+            }
+         }
+      const auto stats = Count_Content(packed_files);
+      for(size_t i = 0u; i < packed.size(); ++i) {
+         if(stats[i].boCompressed) content[packed[i]] = std::to_string(Convert_Size_KiloByte(stats[i].iBytes)) + " KB";
+         }
+      }
+   std::vector<std::string> text(files.size());
+   if(boTextColumns) {
+      std::vector<size_t>   regular;
+      std::vector<fs::path> regular_files;
+      for(size_t i = 0u; i < files.size(); ++i) {
+         if(status[i].boValid && status[i].boRegular) {
+            regular.emplace_back(i);
+            regular_files.emplace_back(files[i]);
+            }
+         }
+      const auto stats = Count_Text(regular_files);
+      for(size_t i = 0u; i < regular.size(); ++i) text[regular[i]] = Text_Values(stats[i]);
+      }
+
+   for(size_t i = 0u; i < files.size(); ++i) {
+      auto const& p = files[i];
+      if(!status[i].boValid) {
+         std::cerr << "error: can't get status of " << p.string() << ": "
+                   << std::error_code(status[i].iError, std::generic_category()).message() << std::endl;
+         }
+      else if(status[i].boDirectory) {
+         std::cout << fs::relative(p, strBase) << std::endl;
+         }
+      else {
+         auto loctime = to_localtime(status[i].tWrite);
+         out << fs::relative(p, strBase).string() << '\t'
+             << std::put_time(&loctime, "%d.%m.%Y %T") << '\t'
+             << Convert_Size_KiloByte(status[i].iSize) << " KB" << '\t'
+             << content[i] << text[i] << std::endl;
+         }
+      }
    }
 
 #ifdef DEBUG
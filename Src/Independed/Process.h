@@ -21,6 +21,10 @@
 #include <vector>
 #include <thread>
 #include <atomic>
+#include <memory>
+#include <functional>
+#include <chrono>
+#include <map>
 
 /**
   \brief tuple with all Data for projects in cbproj- files
@@ -54,30 +58,69 @@ using tplData = std::tuple<std::string,  //  0 project
                            std::string,  // 11 formtype
                            std::string>; // 12 design class
 
+/// file whose rows are counted for a column of a row in the projects, second stage of parsing
+struct TRowRequest {
+   size_t   iRow;      ///< position of the row in the vector of projects
+   int      iColumn;   ///< iMyData_CppRows, iMyData_H_Rows or iMyData_FrmRows
+   fs::path file;
+   };
 
 
+class TPostBuffer;
+
 class TProcess {
    private:
       TMyForm frm;
-      bool boActive = false;
+      bool boActive = false;                      ///< an action runs in the background, only used in the gui thread
+      bool boTextColumns = false;                 ///< wc- style columns in the file and project lists
+      TCountWatcher watcher;
+      std::thread worker;
+      std::atomic<bool> boFinished { false };
+      std::string strRunning;                     ///< name of the running action
+      std::chrono::steady_clock::time_point last_progress;
+      std::vector<std::unique_ptr<TPostBuffer>> posted;
+      std::map<std::string, EReadMode> read_modes; ///< use of the page cache by the actions, cached if missing
        static std::locale myLoc;
       static std::vector<tplList<Latin>> Project_Columns;
       static std::vector<tplList<Latin>> Count_Columns;
       static std::vector<tplList<Latin>> File_Columns;
+      static std::vector<tplList<Latin>> Usage_Columns;
+      static std::vector<tplList<Latin>> Duplicates_Columns;
+      static std::vector<tplList<Latin>> Text_Columns;
 
       static std::set<std::string> project_extensions;
       static std::set<std::string> header_files;
       static std::set<std::string> form_files;
+      static std::string exclude_file;
 
    public:
+      TProcess();
+      ~TProcess();
+
       void Init(TMyForm&& frm);
       void ShowAction();
       void ParseAction();
       void CountAction();
+      void SnapshotAction(bool boFullRescan = false);
+      void WatchAction();
+      void WatchPoll();
+      void UsageAction(size_t iTop = 20u);
+      void DuplicatesAction();
+      void CancelAction();
+      void Poll();
+      void TextColumns(bool boText) { boTextColumns = boText; }
+      void ReadMode(std::string const& strAction, EReadMode eMode) { read_modes[strAction] = eMode; }
 
    private:
      void Parse(fs::path const& fsPath, std::vector<fs::path>& project_files, std::vector<tplData>& projects);
-     void ParseProject(fs::path const& base, fs::path const& strFile, std::vector<tplData>& projects);
+     void ParseProject(fs::path const& base, fs::path const& strFile, std::vector<tplData>& projects,
+                       std::vector<TRowRequest>& requests, TPathResolver& paths, std::ostream& err);
+     void ShowCount(Dir_Stats_Type values);
+     void WriteCount(Dir_Stats_Type values);
+     void PrepareScan(fs::path const& fsPath);
+     void CheckIdle(std::string const& strAction) const;
+     void Run(std::string const& strAction, std::function<void ()> action);
+     void Finish();
 #ifdef DEBUG
 public: //kurztest Process.cpp am Ende
 #endif
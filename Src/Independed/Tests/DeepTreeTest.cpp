@@ -0,0 +1,108 @@
+/**
+ \file
+ \brief   traversal of a generated deep tree and of a wide tree with a small memory budget
+ \details the paths of the deep tree are longer than PATH_MAX, the tree is built and removed
+          with relative paths from the current directory. Only the native backend of linux
+          opens such paths, on other systems the tree is less deep
+*/
+
+#include "TestUtil.h"
+#include "FileUtil.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+#if defined(__linux__)
+const size_t iDepth = 10000u;
+#else
+const size_t iDepth = 50u;
+#endif
+const size_t iFileEvery = 100u;     ///< a file in every 100th level
+const size_t iWidth     = 3000u;
+
+/// chain of directories "d", every iFileEvery level with a file "x.h" of 3 bytes
+void Build_Deep(fs::path const& dir) {
+   const fs::path start = fs::current_path();
+   fs::current_path(dir);
+   for(size_t i = 0u; i < iDepth; ++i) {
+      if(i % iFileEvery == 0u) std::ofstream("x.h") << "abc";
+      fs::create_directory("d");
+      fs::current_path("d");
+      }
+   fs::current_path(start);
+   }
+
+/// bottom up, fs::remove_all() doesn't work with the long paths
+void Remove_Deep(fs::path const& dir) {
+   const fs::path start = fs::current_path();
+   fs::current_path(dir);
+   size_t iLevel = 0u;
+   for(; fs::exists("d"); ++iLevel) fs::current_path("d");
+   for(; iLevel > 0u; --iLevel) {
+      fs::remove("x.h");
+      fs::current_path("..");
+      fs::remove("d");
+      }
+   fs::remove("x.h");
+   fs::current_path(start);
+   }
+
+void Build_Wide(fs::path const& dir) {
+   for(size_t i = 0u; i < iWidth; ++i) {
+      const fs::path sub = dir / ("directory_with_a_longer_name_" + std::to_string(i));
+      fs::create_directory(sub);
+      if(i % 2u == 0u) std::ofstream(sub / "x.h") << "abcde";
+      }
+   }
+
+/// each directory of the chain is opened with its full path, that costs time quadratic in
+/// the depth, so the count is serial and the search parallel
+void Check_Deep(fs::path const& dir) {
+   const size_t iFiles = (iDepth + iFileEvery - 1u) / iFileEvery;
+   Set_Traversal_Threads(1u);
+   const auto stats = Count(dir, true);
+   TEST_CHECK(std::get<0>(stats) == iFiles);
+   TEST_CHECK(std::get<1>(stats) == iDepth);
+   TEST_CHECK(std::get<2>(stats) == 3u * iFiles);
+   Set_Traversal_Threads(4u);
+   std::vector<fs::path> found;
+   TEST_CHECK(Find(found, dir, { ".h" }, true) == iFiles);
+   TEST_CHECK(found.size() == iFiles);
+   }
+
+/// the pending directories go over the budget, the serial and the parallel walk spill them
+void Check_Wide(fs::path const& dir) {
+   Set_Traversal_Memory(4096u);
+   for(unsigned iThreads : { 1u, 4u }) {
+      Set_Traversal_Threads(iThreads);
+      const auto stats = Count(dir, true);
+      TEST_CHECK(std::get<0>(stats) == iWidth / 2u);
+      TEST_CHECK(std::get<1>(stats) == iWidth);
+      TEST_CHECK(std::get<2>(stats) == 5u * (iWidth / 2u));
+      std::vector<fs::path> found;
+      TEST_CHECK(Find(found, dir, { ".h" }, true) == iWidth / 2u);
+      found.clear();
+      TEST_CHECK(Find(found, dir, { }, true) == 0u);   // no extension, no file
+      TEST_CHECK(Find_All(found, dir, true) == iWidth / 2u);
+      }
+   Set_Traversal_Memory(64u * 1024u * 1024u);
+   }
+
+} // end of anonymous namespace
+
+int main() {
+   const fs::path dir = Test_Directory("DeepTreeTest");
+   fs::create_directories(dir / "deep");
+   fs::create_directories(dir / "wide");
+   Set_Traversal_Backend(ETraversalBackend::native);
+   Build_Deep(dir / "deep");
+   Build_Wide(dir / "wide");
+   Check_Deep(dir / "deep");
+   Check_Wide(dir / "wide");
+   Remove_Deep(dir / "deep");
+   fs::remove_all(dir);
+   return Test_Result("DeepTreeTest");
+   }
@@ -0,0 +1,85 @@
+/**
+ \file
+ \brief   known answers of the content hash, and duplicates which are really equal
+*/
+
+#include "TestUtil.h"
+#include "FileUtil.h"
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+namespace {
+
+struct TKnownHash {
+   size_t        iLength;   ///< of the text, the first bytes of the pattern when strText is nullptr
+   char const*   strText;
+   std::uint64_t iLow;
+   std::uint64_t iHigh;
+   };
+
+/// values of the current hash, a change of them makes all content caches invalid
+const TKnownHash known[] = {
+   {    0u, "",                 0xef46db3751d8e999u, 0x0191ee330d9ec246u },
+   {    1u, "a",                0xd24ec4f1a98c6e5bu, 0x5540fa43193c2f40u },
+   {    3u, "abc",              0x44bc2cf5ad770999u, 0x66bbc0a6bfd21c8du },
+   {   14u, "message digest",   0x066ed728fceeb3beu, 0xc626b94e331560e0u },
+   {   62u, "abcdefghijklmnopqrstuvwxyz0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ",
+                                0xd5000c4ac53d14a0u, 0x80477e8f1c72cd76u },
+   {   31u, nullptr,            0x6711d55e306b5d8fu, 0xb556b8aab5cd0d8du },
+   {   32u, nullptr,            0x07f7b8e3bc5d6e25u, 0xf33eb228bc56c723u },
+   {   33u, nullptr,            0x09f85eeb4e1cbe9fu, 0x0eebdd2e4cbf1321u },
+   {   64u, nullptr,            0x50d4159a0411632eu, 0xe024c72e1836fd40u },
+   {  255u, nullptr,            0x15a6db05d4e83df4u, 0xed5d46ef63b9f7acu },
+   { 1000u, nullptr,            0x0bf0bdbcc82eb373u, 0xce07687e4f20421au }
+   };
+
+std::string Pattern(size_t iLength) {
+   std::string ret(iLength, '\0');
+   for(size_t i = 0u; i < iLength; ++i) ret[i] = static_cast<char>((i * 131u + 7u) & 0xFFu);
+   return ret;
+   }
+
+void Write_File(fs::path const& file, std::string const& strContent) {
+   std::ofstream(file, std::ios::binary | std::ios::trunc) << strContent;
+   }
+
+void Known_Answers() {
+   for(auto const& val : known) {
+      const std::string strText = val.strText ? std::string(val.strText) : Pattern(val.iLength);
+      const auto hash = Hash_Content(strText);
+      TEST_CHECK(strText.size() == val.iLength);
+      TEST_CHECK(hash.iLow == val.iLow && hash.iHigh == val.iHigh);
+      }
+   }
+
+/// the hash of a file is the same for the mapped and the streamed reader and the text itself
+void Duplicates(fs::path const& dir) {
+   std::string strContent = Pattern(3u * 1024u * 1024u + 17u);
+   Write_File(dir / "first.bin", strContent);
+   Write_File(dir / "second.bin", strContent);
+   strContent.back() ^= 1;
+   Write_File(dir / "other.bin", strContent);       // same size, not the same content
+   const std::vector<fs::path> files { dir / "first.bin", dir / "other.bin", dir / "second.bin" };
+   for(size_t iMapLimit : { size_t { 0u }, size_t { 1u } << 30 }) {
+      Set_Map_Limit(iMapLimit);
+      fs::remove(dir / "cache");
+      const auto groups = Find_Duplicates(files, dir / "cache");
+      TEST_CHECK(groups.size() == 1u);
+      if(groups.size() != 1u) continue;
+      TEST_CHECK(groups[0].files.size() == 2u);
+      TEST_CHECK(groups[0].hash == Hash_Content(Pattern(3u * 1024u * 1024u + 17u)));
+      for(auto const& file : groups[0].files) TEST_CHECK(file.filename() != "other.bin");
+      }
+   }
+
+} // end of anonymous namespace
+
+int main() {
+   const fs::path dir = Test_Directory("HashTest");
+   Known_Answers();
+   Duplicates(dir);
+   fs::remove_all(dir);
+   return Test_Result("HashTest");
+   }
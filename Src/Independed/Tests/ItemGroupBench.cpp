@@ -0,0 +1,86 @@
+/**
+ \file
+ \brief   time of the parse of a cbproj file: cut after the first ItemGroup and parsed in
+          place, against pugi::xml_document::load_file() of the whole file
+ \details the generated project has the size of a big project of the IDE, the settings
+          behind the first ItemGroup are most of the file. Both ways must find the same
+          rows. Not a test, built when CMake finds pugixml:
+             ItemGroupBench [rows] [repetitions]
+*/
+
+#include "TestUtil.h"
+#include "FileUtil.h"
+
+#include <pugixml.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <string>
+
+namespace {
+
+void Write_Project(fs::path const& file, size_t iRows) {
+   std::ofstream out(file, std::ios::binary);
+   out << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n"
+       << "<Project xmlns=\"http://schemas.microsoft.com/developer/msbuild/2003\">\r\n";
+   for(size_t i = 0u; i < 40u; ++i)
+      out << "   <PropertyGroup Condition=\"'$(Config)'=='Cfg_" << i << "' or '$(Cfg_" << i << ")'!=''\">\r\n"
+          << "      <Cfg_" << i << ">true</Cfg_" << i << ">\r\n      <CfgParent>Base</CfgParent>\r\n   </PropertyGroup>\r\n";
+   out << "   <ItemGroup>\r\n";
+   for(size_t i = 0u; i < iRows; ++i)
+      out << "      <CppCompile Include=\"Source\\Unit_" << i << ".cpp\">\r\n"
+          << "         <Form>frmUnit_" << i << "</Form>\r\n         <FormType>dfm</FormType>\r\n"
+          << "         <DependentOn>Source\\Unit_" << i << ".h</DependentOn>\r\n"
+          << "         <BuildOrder>" << i << "</BuildOrder>\r\n      </CppCompile>\r\n";
+   out << "   </ItemGroup>\r\n   <ProjectExtensions>\r\n      <Borland.Personality>CPlusPlusBuilder.Personality.12</Borland.Personality>\r\n"
+       << "      <BorlandProject>\r\n         <CPlusPlusBuilder.Personality>\r\n";
+   for(size_t i = 0u; i < 50u * iRows; ++i)
+      out << "            <Excluded_Packages Name=\"$(BDSBIN)\\package_" << i << ".bpl\">Package " << i << "</Excluded_Packages>\r\n";
+   out << "         </CPlusPlusBuilder.Personality>\r\n      </BorlandProject>\r\n   </ProjectExtensions>\r\n</Project>\r\n";
+   }
+
+size_t Rows(pugi::xml_document const& doc) {
+   size_t ret = 0u;
+   for(auto node = doc.document_element().child("ItemGroup").first_child(); node; node = node.next_sibling()) ++ret;
+   return ret;
+   }
+
+template <typename func_type>
+double Milliseconds(size_t iRepetitions, func_type&& func) {
+   const auto start = std::chrono::steady_clock::now();
+   for(size_t i = 0u; i < iRepetitions; ++i) func();
+   return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iRepetitions;
+   }
+
+} // end of anonymous namespace
+
+int main(int argc, char* argv[]) {
+   const size_t iRows        = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 500u;
+   const size_t iRepetitions = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 20u;
+   const fs::path dir  = Test_Directory("ItemGroupBench");
+   const fs::path file = dir / "Project.cbproj";
+   Write_Project(file, iRows);
+
+   size_t iWhole = 0u, iCut = 0u;
+   const double dWhole = Milliseconds(iRepetitions, [&]() {
+      pugi::xml_document doc;
+      if(doc.load_file(file.string().c_str(), pugi::parse_default | pugi::parse_fragment)) iWhole = Rows(doc);
+      });
+   const double dCut = Milliseconds(iRepetitions, [&]() {
+      TFileCopy content(file);
+      pugi::xml_document doc;
+      const size_t iPart = Cut_After_ItemGroup(content.data(), content.size());
+      if(doc.load_buffer_inplace(content.data(), iPart, pugi::parse_minimal | pugi::parse_escapes | pugi::parse_fragment)) iCut = Rows(doc);
+      });
+   TEST_CHECK(iWhole == iRows);
+   TEST_CHECK(iCut == iRows);
+
+   std::cout << std::fixed << std::setprecision(3)
+             << fs::file_size(file) / 1024u << " KB, " << iRows << " rows" << std::endl
+             << "load_file:                " << dWhole << " ms" << std::endl
+             << "cut and parse in place:   " << dCut << " ms" << std::endl;
+   fs::remove_all(dir);
+   return Test_Result("ItemGroupBench");
+   }
@@ -0,0 +1,74 @@
+/**
+ \file
+ \brief   the part of a cbproj file up to the first ItemGroup, with the root closed behind it
+ \details texts with the markup which a search for the strings would take for tags:
+          comments, CDATA sections and '>' in values of attributes. A first ItemGroup
+          which isn't a child of the root leaves the text as it is.
+*/
+
+#include "TestUtil.h"
+#include "FileUtil.h"
+
+#include <string>
+
+namespace {
+
+const std::string strHead  = "<?xml version=\"1.0\" encoding=\"utf-8\"?>\r\n";
+const std::string strGroup = "<ItemGroup>\r\n"
+                             "   <CppCompile Include=\"a.cpp\"><BuildOrder>1</BuildOrder></CppCompile>\r\n"
+                             "   <CppCompile Include=\"b.cpp\"/>\r\n"
+                             "</ItemGroup>";
+const std::string strTail  = "\r\n<ItemGroup><None Include=\"x.txt\"/></ItemGroup>\r\n"
+                             "<ProjectExtensions><Borland.Personality>CPlusPlusBuilder.Personality.12</Borland.Personality>"
+                             "</ProjectExtensions>\r\n</Project>\r\n";
+
+/// the part which the cut gives, empty when the text isn't cut, the text must stay as it is then
+std::string Cut(std::string const& strText) {
+   std::string strCopy = strText;
+   const size_t iPart = Cut_After_ItemGroup(strCopy.data(), strCopy.size());
+   if(iPart == strCopy.size()) {
+      TEST_CHECK(strCopy == strText);
+      return { };
+      }
+   return strCopy.substr(0u, iPart);
+   }
+
+void Check_Cut(std::string const& strBefore) {
+   const std::string strText = strBefore + strGroup + strTail;
+   TEST_CHECK(Cut(strText) == strBefore + strGroup + "</Project>");
+   }
+
+} // end of anonymous namespace
+
+int main() {
+   const std::string strRoot = "<Project xmlns=\"http://schemas.microsoft.com/developer/msbuild/2003\">\r\n";
+   // the usual project, '>' and "/>" in values of attributes
+   Check_Cut(strHead + strRoot);
+   Check_Cut(strHead + strRoot + "<PropertyGroup Condition=\"'$(Base)'=='x>y'\" Label='a/>'/>\r\n");
+   // a comment before the root, its '<' isn't the root
+   Check_Cut(strHead + "<!-- <Other> isn't the root -->\r\n" + strRoot);
+   Check_Cut("<!DOCTYPE Project [ <!ENTITY e \"<x>\"> ]>\r\n" + strRoot);
+   // "</ItemGroup>" in a comment and a CDATA section, before and in the first ItemGroup
+   Check_Cut(strHead + strRoot + "<!-- </ItemGroup> -->\r\n");
+   Check_Cut(strHead + strRoot + "<Description><![CDATA[ <ItemGroup></ItemGroup> ]]></Description>\r\n");
+   {
+   const std::string strInside = strHead + strRoot + "<ItemGroup>\r\n<!-- </ItemGroup> --><CppCompile Include=\"a.cpp\"/>\r\n</ItemGroup>";
+   TEST_CHECK(Cut(strInside + strTail) == strInside + "</Project>");
+   }
+   // an empty first ItemGroup is the one ParseProject() takes
+   {
+   const std::string strEmpty = strHead + strRoot + "<ItemGroup/>";
+   TEST_CHECK(Cut(strEmpty + strTail) == strEmpty + "</Project>");
+   }
+   // a nested first ItemGroup needs the elements around it, the whole text is parsed
+   TEST_CHECK(Cut(strHead + strRoot + "<Choose><When Condition=\"true\">" + strGroup + "</When></Choose>\r\n" +
+                  strGroup + strTail).empty());
+   // no ItemGroup, no room for the close of the root, broken markup
+   TEST_CHECK(Cut(strHead + strRoot + "<PropertyGroup/>\r\n</Project>").empty());
+   TEST_CHECK(Cut(strHead + strRoot + strGroup + "</P").empty());
+   TEST_CHECK(Cut(strHead + strRoot + "<!-- open comment " + strGroup + strTail).empty());
+   TEST_CHECK(Cut(strHead + strRoot + "<PropertyGroup Label=\"open>" + strGroup + strTail).empty());
+   TEST_CHECK(Cut("").empty());
+   TEST_CHECK(Cut("<").empty());
+   return Test_Result("ItemGroupTest");
+   }
@@ -0,0 +1,88 @@
+/**
+ \file
+ \brief   the vector kernels give byte for byte the results of the scalar kernel
+ \details random buffers with many of the bytes the kernels look for, at every alignment
+          to 64 bytes and with every tail length from 0 to 127 behind the full vectors.
+          Kernels the processor doesn't support are left out.
+*/
+
+#include "TestUtil.h"
+#include "FileUtil.h"
+
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+/// the bytes which the kernels handle in a special way, and some others
+const char interesting[] = "\n\r \t\v\f/*#\"'\\abz09_{};\xA0\xC3\xFF";
+
+std::string Random_Text(std::mt19937& rng, size_t iLength) {
+   std::uniform_int_distribution<int> pick(0, sizeof(interesting) - 2);
+   std::uniform_int_distribution<int> any(0, 255);
+   std::uniform_int_distribution<int> coin(0, 3);
+   std::string ret(iLength, '\0');
+   for(auto& ch : ret) ch = coin(rng) == 0 ? static_cast<char>(any(rng)) : interesting[pick(rng)];
+   return ret;
+   }
+
+bool Equal(TLineStats const& lhs, TLineStats const& rhs) {
+   return lhs.iRows == rhs.iRows && lhs.iCode == rhs.iCode && lhs.iComment == rhs.iComment &&
+          lhs.iBlank == rhs.iBlank && lhs.iPreprocessor == rhs.iPreprocessor;
+   }
+
+bool Equal(TTextStats const& lhs, TTextStats const& rhs) {
+   return lhs.iBytes == rhs.iBytes && lhs.iLines == rhs.iLines && lhs.iWords == rhs.iWords &&
+          lhs.iLongest == rhs.iLongest && lhs.iLF == rhs.iLF && lhs.iCRLF == rhs.iCRLF &&
+          lhs.iCR == rhs.iCR && lhs.lengths == rhs.lengths;
+   }
+
+/// all kernels for the same text, the first one is the scalar kernel as reference
+void Compare(std::string_view text) {
+   Set_Row_Kernel(ERowKernel::scalar);
+   const size_t iRows    = Count_Newlines(text);
+   const TLineStats cpp  = Classify_Lines(text, ELineSyntax::cpp);
+   const TLineStats form = Classify_Lines(text, ELineSyntax::text);
+   const TTextStats wc   = Text_Stats(text);
+   for(auto eKernel : { ERowKernel::sse2, ERowKernel::avx2, ERowKernel::avx512 }) {
+      if(!Set_Row_Kernel(eKernel)) continue;
+      TEST_CHECK(Count_Newlines(text) == iRows);
+      TEST_CHECK(Equal(Classify_Lines(text, ELineSyntax::cpp), cpp));
+      TEST_CHECK(Equal(Classify_Lines(text, ELineSyntax::text), form));
+      TEST_CHECK(Equal(Text_Stats(text), wc));
+      }
+   }
+
+/// every alignment and tail behind 0, 1 and 2 full vectors of 64 bytes
+void Alignments_And_Tails(std::mt19937& rng) {
+   const std::string buffer = Random_Text(rng, 64u + 2u * 64u + 128u);
+   for(size_t iOffset = 0u; iOffset < 64u; ++iOffset) {
+      for(size_t iVectors = 0u; iVectors <= 2u; ++iVectors) {
+         for(size_t iTail = 0u; iTail < 128u; ++iTail)
+            Compare(std::string_view(buffer).substr(iOffset, iVectors * 64u + iTail));
+         }
+      }
+   }
+
+/// longer texts across the blocks of the line classifier
+void Long_Texts(std::mt19937& rng) {
+   std::uniform_int_distribution<size_t> length(1000u, 300000u);
+   std::uniform_int_distribution<size_t> offset(0u, 63u);
+   for(int i = 0; i < 40; ++i) {
+      const std::string buffer = Random_Text(rng, length(rng) + 64u);
+      Compare(std::string_view(buffer).substr(offset(rng)));
+      }
+   }
+
+} // end of anonymous namespace
+
+int main() {
+   std::mt19937 rng(20240611u);    // fixed, a failure can be repeated
+   const ERowKernel eBest = Get_Row_Kernel();
+   Alignments_And_Tails(rng);
+   Long_Texts(rng);
+   Set_Row_Kernel(eBest);
+   return Test_Result("KernelTest");
+   }
@@ -0,0 +1,108 @@
+/**
+ \file
+ \brief   the read modes dontneed and direct leave the scanned files out of the page cache
+ \details the files are written and dropped from the cache with posix_fadvise, the
+          footprint of a scan is measured with Resident_Bytes() (mincore). Where the cache
+          can't be dropped (tmpfs) or mincore isn't known (not linux) the test is skipped.
+*/
+
+#include "TestUtil.h"
+#include "FileUtil.h"
+
+#include <fstream>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+   #include <fcntl.h>
+   #include <unistd.h>
+#endif
+
+namespace {
+
+const size_t iFiles    = 4u;
+const size_t iFileSize = 8u * 1024u * 1024u;
+const size_t iLineSize = 64u;               ///< with the '\n'
+const std::uint64_t iTolerance = 256u * 1024u;   ///< pages of other readers of the files, e.g. the read ahead of the last block
+
+std::vector<fs::path> Write_Files(fs::path const& dir) {
+   std::string strLine(iLineSize - 1u, 'x');
+   strLine.push_back('\n');
+   std::string strContent;
+   for(size_t i = 0u; i < iFileSize / iLineSize; ++i) strContent += strLine;
+   std::vector<fs::path> files;
+   for(size_t i = 0u; i < iFiles; ++i) {
+      files.emplace_back(dir / ("file_" + std::to_string(i) + ".txt"));
+      std::ofstream(files.back(), std::ios::binary | std::ios::trunc) << strContent;
+      }
+   return files;
+   }
+
+/// write back and drop the pages of the files, false when they stay in the cache
+bool Drop_Cache(std::vector<fs::path> const& files) {
+#if defined(__linux__)
+   for(auto const& file : files) {
+      const int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+      if(fd < 0) return false;
+      ::fdatasync(fd);
+      ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+      ::close(fd);
+      }
+   return Resident_Bytes(files) <= iTolerance;
+#else
+   static_cast<void>(files);
+   return false;
+#endif
+   }
+
+void Check_Rows(std::vector<fs::path> const& files) {
+   const auto rows = Count_Rows(files);
+   TEST_CHECK(rows.size() == files.size());
+   for(auto iRows : rows) TEST_CHECK(iRows == iFileSize / iLineSize);
+   }
+
+/// cold files stay out of the cache, with the mapped and with the read path of cached
+void Cold_Files(std::vector<fs::path> const& files) {
+   const std::uint64_t iTotal = iFiles * iFileSize;
+   for(size_t iMapLimit : { size_t { 0u }, size_t { 1u } << 30 }) {
+      Set_Map_Limit(iMapLimit);
+      for(auto eMode : { EReadMode::dontneed, EReadMode::direct }) {
+         TEST_CHECK(Drop_Cache(files));
+         Set_Read_Mode(eMode);
+         Check_Rows(files);
+         TEST_CHECK(Resident_Bytes(files) <= iTolerance);
+         }
+      // the measurement itself, cached brings the files into the cache
+      TEST_CHECK(Drop_Cache(files));
+      Set_Read_Mode(EReadMode::cached);
+      Check_Rows(files);
+      TEST_CHECK(Resident_Bytes(files) >= iTotal / 2u);
+      }
+   }
+
+/// pages which were in the cache before the scan aren't dropped by dontneed
+void Warm_Files(std::vector<fs::path> const& files) {
+   const std::uint64_t iTotal = iFiles * iFileSize;
+   Set_Read_Mode(EReadMode::cached);
+   Check_Rows(files);
+   const std::uint64_t iBefore = Resident_Bytes(files);
+   TEST_CHECK(iBefore >= iTotal / 2u);
+   Set_Read_Mode(EReadMode::dontneed);
+   Check_Rows(files);
+   TEST_CHECK(Resident_Bytes(files) >= iBefore);
+   }
+
+} // end of anonymous namespace
+
+int main() {
+   const fs::path dir = Test_Directory("ReadModeTest");
+   const auto files = Write_Files(dir);
+   if(Drop_Cache(files)) {
+      Cold_Files(files);
+      Warm_Files(files);
+      }
+   else std::cout << "ReadModeTest: the page cache can't be dropped here, skipped" << std::endl;
+   Set_Read_Mode(EReadMode::cached);
+   fs::remove_all(dir);
+   return Test_Result("ReadModeTest");
+   }
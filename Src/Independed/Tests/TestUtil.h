@@ -0,0 +1,44 @@
+/**
+ \file
+ \brief   minimal checks for the tests of the file utilities, without a test framework
+ \details a failed check is reported with its position and the test goes on, the result
+          of Test_Result() is the exit code of the test program
+*/
+
+#ifndef TestUtilH
+#define TestUtilH
+
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+namespace fs = std::filesystem;
+
+inline int& Test_Failures() {
+   static int iFailures = 0;
+   return iFailures;
+   }
+
+#define TEST_CHECK(condition) \
+   do { \
+      if(!(condition)) { \
+         ++Test_Failures(); \
+         std::cerr << __FILE__ << "(" << __LINE__ << "): check failed: " #condition << std::endl; \
+         } \
+      } while(false)
+
+inline int Test_Result(char const* strTest) {
+   std::cout << strTest << ": " << (Test_Failures() == 0 ? "passed" : "failed") << ", "
+             << Test_Failures() << " failed check(s)" << std::endl;
+   return Test_Failures() == 0 ? 0 : 1;
+   }
+
+/// empty directory for the files of a test, in the temporary directory
+inline fs::path Test_Directory(std::string const& strTest) {
+   const fs::path dir = fs::temp_directory_path() / ("FileUtil_" + strTest);
+   fs::remove_all(dir);
+   fs::create_directories(dir);
+   return dir;
+   }
+
+#endif
@@ -0,0 +1,58 @@
+/**
+ \file
+ \brief   a file truncated under its mapping gives a filesystem_error instead of SIGBUS
+ \details the private copy of a file is mapped, the file is truncated to one page and the
+          whole copy is read. The pages behind the new end are read as zeros, Check()
+          reports the truncation. Without the mapping (not linux) the test is skipped.
+*/
+
+#include "TestUtil.h"
+#include "FileUtil.h"
+
+#include <fstream>
+#include <string>
+
+namespace {
+
+const size_t iFileSize = 1024u * 1024u;
+const size_t iKeep     = 4096u;
+
+/// sum of all bytes, every page is touched
+size_t Sum(TFileCopy& copy) {
+   size_t ret = 0u;
+   for(size_t i = 0u; i < copy.size(); ++i) ret += static_cast<unsigned char>(copy.data()[i]);
+   return ret;
+   }
+
+bool Check_Throws(TFileCopy const& copy) {
+   try {
+      copy.Check();
+      }
+   catch(fs::filesystem_error const&) {
+      return true;
+      }
+   return false;
+   }
+
+} // end of anonymous namespace
+
+int main() {
+#if defined(__linux__)
+   const fs::path dir  = Test_Directory("TruncateTest");
+   const fs::path file = dir / "content.txt";
+   std::ofstream(file, std::ios::binary) << std::string(iFileSize, 'x');
+   {
+   TFileCopy copy(file);
+   TEST_CHECK(copy.size() == iFileSize);
+   TEST_CHECK(Sum(copy) == iFileSize * 'x');
+   TEST_CHECK(!Check_Throws(copy));
+   fs::resize_file(file, iKeep);
+   TEST_CHECK(Sum(copy) <= iKeep * 'x');   // the kernel may keep the page behind the new end
+   TEST_CHECK(Check_Throws(copy));
+   }
+   fs::remove_all(dir);
+#else
+   std::cout << "TruncateTest: files aren't mapped here, skipped" << std::endl;
+#endif
+   return Test_Result("TruncateTest");
+   }
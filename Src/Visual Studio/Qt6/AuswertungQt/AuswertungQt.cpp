@@ -1,5 +1,6 @@
 #include "AuswertungQt.h"
 #include <QMessagebox>
+#include <QShortcut>
 
 AuswertungQt::AuswertungQt(QWidget *parent)
     : QMainWindow(parent)
@@ -15,6 +16,17 @@ AuswertungQt::AuswertungQt(QWidget *parent)
     connect(ui.btnCount, SIGNAL(clicked()), this, SLOT(Count()));
     connect(ui.btnShow, SIGNAL(clicked()), this, SLOT(Show()));
     connect(ui.btnParse, SIGNAL(clicked()), this, SLOT(Parse()));
+    connect(ui.btnSnapshot, SIGNAL(clicked()), this, SLOT(Snapshot()));
+    connect(ui.btnRescan, SIGNAL(clicked()), this, SLOT(Rescan()));
+    connect(ui.btnWatch, SIGNAL(clicked()), this, SLOT(Watch()));
+    connect(ui.btnDuplicates, SIGNAL(clicked()), this, SLOT(Duplicates()));
+
+    // actions run in the background, output and progress are fetched by the timer
+    pollTimer = new QTimer(this);
+    connect(pollTimer, SIGNAL(timeout()), this, SLOT(Poll()));
+    pollTimer->start(100);
+    auto cancelKey = new QShortcut(QKeySequence(Qt::Key_Escape), this);
+    connect(cancelKey, SIGNAL(activated()), this, SLOT(Cancel()));
 
     try {
        proc.Init({ this, false });
@@ -64,3 +76,55 @@ void AuswertungQt::Count() {
       msg.exec();
    }
 }
+
+void AuswertungQt::Snapshot() {
+   try {
+      proc.SnapshotAction();
+   }
+   catch (std::exception& ex) {
+      QMessageBox msg;
+      msg.setText(ex.what());
+      msg.exec();
+   }
+}
+
+void AuswertungQt::Rescan() {
+   try {
+      proc.SnapshotAction(true);
+   }
+   catch (std::exception& ex) {
+      QMessageBox msg;
+      msg.setText(ex.what());
+      msg.exec();
+   }
+}
+
+void AuswertungQt::Watch() {
+   try {
+      proc.WatchAction();
+   }
+   catch (std::exception& ex) {
+      QMessageBox msg;
+      msg.setText(ex.what());
+      msg.exec();
+   }
+}
+
+void AuswertungQt::Duplicates() {
+   try {
+      proc.DuplicatesAction();
+   }
+   catch (std::exception& ex) {
+      QMessageBox msg;
+      msg.setText(ex.what());
+      msg.exec();
+   }
+}
+
+void AuswertungQt::Poll() {
+   proc.Poll();
+}
+
+void AuswertungQt::Cancel() {
+   proc.CancelAction();
+}
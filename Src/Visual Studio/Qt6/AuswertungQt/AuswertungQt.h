@@ -4,6 +4,7 @@
 #include "ui_AuswertungQt.h"
 
 #include <QLabel>
+#include <QTimer>
 #include "Process.h"
 
 class AuswertungQt : public QMainWindow
@@ -17,6 +18,7 @@ public:
 private:
     Ui::AuswertungQtClass ui;
     QLabel* statusLabel;
+    QTimer* pollTimer;
 
     TProcess proc;
 
@@ -24,4 +26,10 @@ private slots:
    void Parse();
    void Show();
    void Count();
+   void Snapshot();
+   void Rescan();
+   void Watch();
+   void Duplicates();
+   void Poll();
+   void Cancel();
 };